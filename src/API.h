@@ -58,6 +58,26 @@
 
 #define JOY_THRESHOLD 256
 #define INVALID_JOY -1
+#define JOY_ANY -3     // Aggregate of all devices (see Any.h)
+
+// Event mask bits (see JoystickEvent in the script header)
+#define JOY_EVENT_MOVE  1
+#define JOY_EVENT_PRESS 2
+#define JOY_EVENT_POV   4
+#define JOY_EVENT_ALL   7
+
+// Sampling modes (see JoystickSampling in the script header)
+#define JOY_SAMPLE_PRERENDER 1
+#define JOY_SAMPLE_FINALDRAW 2
+#define JOY_SAMPLE_BOTH      3
+#define JOY_SAMPLE_LATEST    4
+
+// Hidden debug queries (JoystickName with a negative index)
+#define JOY_DEBUG_VERSION  -2
+#define JOY_DEBUG_LATENCY  -3
+#define JOY_DEBUG_COUNTERS -4
+#define JOY_DEBUG_TRACE    -5
+#define JOY_DEBUG_PROFILE  -6
 
 //------------------------------------------------------------------------------
 // Macros
@@ -0,0 +1,343 @@
+/**********************************************************
+ * Input actions -- See header file for more information. *
+ **********************************************************/
+
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+
+#include "Action.h"
+#include "Mapping.h"
+
+//------------------------------------------------------------------------------
+
+namespace AGSJoyAction {
+
+struct Binding
+{
+	long action, joystick, type, index, threshold, value;
+};
+
+struct Set
+{
+	std::string name;
+	std::vector<Binding> bindings; // As declared, the table is built from these
+	Table table;
+};
+
+std::vector<std::string> names;   // Action IDs are indices
+Set base;                         // Default set (0)
+std::vector<Set *> sets(1, &base);
+const Table *active = &base.table;
+
+std::map<long, long> rooms;       // Room number to set
+long restore = -1, entered = -1;  // Sets before and after entering a room
+
+uint32_t down[ACTION_MAX / 32];   // Evaluated state
+int32_t values[ACTION_MAX];
+
+//------------------------------------------------------------------------------
+
+bool ByJoystick(const Digital &a, const Digital &b) { return a.joystick < b.joystick; }
+bool ByJoystickAnalog(const Analog &a, const Analog &b) { return a.joystick < b.joystick; }
+
+void Compile(Set &set)
+{
+	Table &table = set.table;
+	table.digital.clear();
+	table.analog.clear();
+	
+	for (size_t i = 0; i < set.bindings.size(); ++i)
+	{
+		const Binding &b = set.bindings[i];
+		if (b.type >= BIND_AXIS)
+		{
+			Analog a;
+			a.action = (uint16_t) b.action;
+			a.joystick = (uint8_t) b.joystick;
+			a.pad = (b.type >= BIND_PAD_AXIS) ? 1 : 0;
+			a.index = (uint8_t) b.index;
+			int half = (b.type - BIND_AXIS) % 3;
+			a.half = (half == 1) ? 1 : (half == 2) ? -1 : 0;
+			a.threshold = b.threshold;
+			table.analog.push_back(a);
+			continue;
+		}
+		
+		Digital d;
+		d.action = (uint16_t) b.action;
+		d.joystick = (uint8_t) b.joystick;
+		d.value = b.value;
+		switch (b.type)
+		{
+			case BIND_BUTTON:     d.word = 0; d.mask = 1UL << b.index; break;
+			case BIND_BUTTONS:    d.word = 0; d.mask = (uint32_t) b.index; break;
+			case BIND_POV:        d.word = 1; d.mask = (uint32_t) b.index; break;
+			case BIND_PAD_BUTTON: d.word = 2; d.mask = 1UL << b.index; break;
+		}
+		table.digital.push_back(d);
+	}
+	
+	// A joystick's bindings together read its state while it is in cache
+	std::stable_sort(table.digital.begin(), table.digital.end(), ByJoystick);
+	std::stable_sort(table.analog.begin(), table.analog.end(), ByJoystickAnalog);
+	if (active == &table)
+		Reset();
+}
+
+//------------------------------------------------------------------------------
+
+void Evaluate(const Source *sources)
+{
+	size_t count = names.size();
+	int32_t pos[ACTION_MAX], neg[ACTION_MAX];
+	memset(down, 0, sizeof (down));
+	memset(pos, 0, count * sizeof (int32_t));
+	memset(neg, 0, count * sizeof (int32_t));
+	
+	const Table &table = *active;
+	for (size_t i = 0; i < table.digital.size(); ++i)
+	{
+		const Digital &d = table.digital[i];
+		const Source &s = sources[d.joystick];
+		if (!s.present || (s.word[d.word] & d.mask) != d.mask)
+			continue;
+		
+		down[d.action >> 5] |= 1UL << (d.action & 31);
+		if (d.value > pos[d.action])
+			pos[d.action] = d.value;
+		else if (d.value < neg[d.action])
+			neg[d.action] = d.value;
+	}
+	
+	for (size_t i = 0; i < table.analog.size(); ++i)
+	{
+		const Analog &a = table.analog[i];
+		const Source &s = sources[a.joystick];
+		if (!s.present)
+			continue;
+		
+		int32_t v = s.axis[a.pad][a.index];
+		if ((a.half > 0 && v < 0) || (a.half < 0 && v > 0))
+			v = 0;
+		
+		if (v > a.threshold || v < -a.threshold)
+			down[a.action >> 5] |= 1UL << (a.action & 31);
+		if (v > pos[a.action])
+			pos[a.action] = v;
+		else if (v < neg[a.action])
+			neg[a.action] = v;
+	}
+	
+	for (size_t i = 0; i < count; ++i)
+	{
+		int32_t v = pos[i] + neg[i];
+		values[i] = (v > 32767) ? 32767 : (v < -32768) ? -32768 : v;
+	}
+}
+
+//------------------------------------------------------------------------------
+
+bool Active()
+{
+	return !active->digital.empty() || !active->analog.empty();
+}
+
+//------------------------------------------------------------------------------
+
+void Reset()
+{
+	memset(down, 0, sizeof (down));
+	memset(values, 0, sizeof (values));
+}
+
+//------------------------------------------------------------------------------
+
+void Clear()
+{
+	for (size_t i = 1; i < sets.size(); ++i)
+		delete sets[i];
+	sets.assign(1, &base);
+	active = &base.table;
+	
+	names.clear();
+	base.bindings.clear();
+	Compile(base);
+	
+	rooms.clear();
+	restore = entered = -1;
+}
+
+//==============================================================================
+
+long Declare(const char *name)
+{
+	if (!name)
+		return -1;
+	
+	for (size_t i = 0; i < names.size(); ++i)
+		if (names[i] == name)
+			return (long) i;
+	
+	if (names.size() >= ACTION_MAX)
+		return -1;
+	
+	names.push_back(name);
+	return (long) names.size() - 1;
+}
+
+//------------------------------------------------------------------------------
+
+bool Bind(long set, long action, long joystick, long type, long index, long threshold, long value)
+{
+	if (set < 0 || set >= (long) sets.size()
+	|| action < 0 || action >= (long) names.size()
+	|| joystick < 0 || joystick >= ACTION_JOYSTICKS
+	|| type < BIND_BUTTON || type >= BIND_TYPES)
+		return false;
+	
+	long limit;
+	switch (type)
+	{
+		case BIND_BUTTON:     limit = 32; break;
+		case BIND_PAD_BUTTON: limit = AGSJoyMap::PAD_BUTTONS; break;
+		case BIND_POV:        limit = 16; break;
+		case BIND_BUTTONS:    limit = 0; break; // Any mask
+		default:              limit = 6; break; // Raw and pad axes alike
+	}
+	if (limit ? (index < 0 || index >= limit) : !index)
+		return false;
+	if ((type == BIND_POV && !index) || threshold < 0 || threshold > 32767
+	|| value < -32768 || value > 32767)
+		return false;
+	
+	Binding b = { action, joystick, type, index, threshold, value };
+	sets[set]->bindings.push_back(b);
+	Compile(*sets[set]);
+	return true;
+}
+
+//------------------------------------------------------------------------------
+
+void Unbind(long set, long action)
+{
+	if (set < 0 || set >= (long) sets.size())
+		return;
+	
+	std::vector<Binding> &bindings = sets[set]->bindings;
+	size_t kept = 0;
+	for (size_t i = 0; i < bindings.size(); ++i)
+		if (bindings[i].action != action)
+			bindings[kept++] = bindings[i];
+	bindings.resize(kept);
+	Compile(*sets[set]);
+}
+
+//------------------------------------------------------------------------------
+
+bool Down(long action)
+{
+	if (action < 0 || action >= ACTION_MAX)
+		return false;
+	return (down[action >> 5] >> (action & 31)) & 1;
+}
+
+long Value(long action)
+{
+	if (action < 0 || action >= ACTION_MAX)
+		return 0;
+	return values[action];
+}
+
+//==============================================================================
+
+long DeclareSet(const char *name)
+{
+	if (!name)
+		return -1;
+	
+	for (size_t i = 0; i < sets.size(); ++i)
+		if (sets[i]->name == name)
+			return (long) i;
+	
+	if (sets.size() >= ACTION_SETS)
+		return -1;
+	
+	Set *set = new Set;
+	set->name = name;
+	sets.push_back(set);
+	return (long) sets.size() - 1;
+}
+
+//------------------------------------------------------------------------------
+
+bool Activate(long set)
+{
+	if (set < 0 || set >= (long) sets.size())
+		return false;
+	
+	// The next update evaluates the new set; until then nothing is down
+	if (active != &sets[set]->table)
+	{
+		active = &sets[set]->table;
+		Reset();
+	}
+	return true;
+}
+
+long Current()
+{
+	for (size_t i = 0; i < sets.size(); ++i)
+		if (active == &sets[i]->table)
+			return (long) i;
+	return 0;
+}
+
+//------------------------------------------------------------------------------
+
+bool Room(long room, long set)
+{
+	if (set < -1 || set >= (long) sets.size())
+		return false;
+	
+	if (set < 0)
+		rooms.erase(room);
+	else
+		rooms[room] = set;
+	return true;
+}
+
+bool Rooms()
+{
+	return !rooms.empty();
+}
+
+//------------------------------------------------------------------------------
+
+void Enter(long room)
+{
+	std::map<long, long>::const_iterator it = rooms.find(room);
+	if (it == rooms.end())
+		return;
+	
+	restore = Current();
+	entered = it->second;
+	Activate(entered);
+}
+
+void Leave()
+{
+	if (entered < 0)
+		return;
+	
+	if (Current() == entered)
+		Activate(restore);
+	restore = entered = -1;
+}
+
+//------------------------------------------------------------------------------
+
+} /* namespace AGSJoyAction */
+
+//..............................................................................
@@ -0,0 +1,145 @@
+/*******************************************************
+ * Input actions -- header file                        *
+ *                                                     *
+ * Author: agent                                       *
+ *                                                     *
+ * Date: 21:40 19-10-2026                              *
+ *                                                     *
+ * Description: Named actions bound to controller      *
+ *              inputs in switchable sets, evaluated   *
+ *              once per update.                       *
+ *******************************************************/
+
+#ifndef _ACTION_H
+#define _ACTION_H
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+/// Input actions
+namespace AGSJoyAction {
+
+//------------------------------------------------------------------------------
+// Bindings (see JoystickBind in the script header). Digital ones are down
+// when all bits of their mask are set and then add their value; analog ones
+// add the axis value and are down beyond their threshold. The strongest
+// push in either direction counts, so opposite inputs cancel out.
+
+enum BindType
+{
+	BIND_BUTTON = 1,   // Raw button number
+	BIND_BUTTONS,      // Raw buttons (mask, all held)
+	BIND_POV,          // Pov directions (all held)
+	BIND_PAD_BUTTON,   // Standard gamepad button number
+	BIND_AXIS,         // Raw axis, both directions
+	BIND_AXIS_POS,     // Raw axis, positive half
+	BIND_AXIS_NEG,     // Raw axis, negative half
+	BIND_PAD_AXIS,     // Standard gamepad axis, both directions
+	BIND_PAD_AXIS_POS,
+	BIND_PAD_AXIS_NEG,
+	BIND_TYPES
+};
+
+#define ACTION_MAX        256 // Actions that can be declared
+#define ACTION_JOYSTICKS  32  // Joystick IDs that can be bound
+#define ACTION_THRESHOLD  16384
+#define ACTION_VALUE      32767
+#define ACTION_SETS       64  // Sets that can be declared, including the default
+
+//------------------------------------------------------------------------------
+// Compiled tables, rebuilt whenever a binding of their set changes. Every set
+// has its own; the actions (names and IDs) are shared by all of them.
+
+struct Digital
+{
+	uint16_t action;
+	uint8_t joystick;
+	uint8_t word;      // Source::word index
+	uint32_t mask;
+	int32_t value;
+};
+
+struct Analog
+{
+	uint16_t action;
+	uint8_t joystick;
+	uint8_t pad;       // Source::axis index (0 raw, 1 pad)
+	uint8_t index;
+	int8_t half;       // 1 positive, -1 negative, 0 both
+	int32_t threshold;
+};
+
+struct Table
+{
+	std::vector<Digital> digital; // Grouped by joystick
+	std::vector<Analog> analog;
+};
+
+//------------------------------------------------------------------------------
+// What Evaluate reads of an open joystick
+
+struct Source
+{
+	bool present;
+	uint32_t word[3];        // Buttons, pov, pad buttons
+	const int32_t *axis[2];  // Axes x-w, pad axes
+};
+
+/// Evaluates the active set against the open joysticks (ACTION_JOYSTICKS sources)
+void Evaluate(const Source *sources);
+
+/// Whether the active set has anything to evaluate
+bool Active();
+
+/// Releases everything (nothing is open, so nothing is down)
+void Reset();
+
+void Clear();
+
+//------------------------------------------------------------------------------
+// Script side
+
+/// Returns the ID of the named action, declaring it if needed (-1 when full)
+long Declare(const char *name);
+
+/// Adds a binding to a set, false when something is out of range
+bool Bind(long set, long action, long joystick, long type, long index, long threshold, long value);
+
+/// Removes all bindings of an action from a set
+void Unbind(long set, long action);
+
+bool Down(long action);
+long Value(long action);
+
+//------------------------------------------------------------------------------
+// Sets. Set 0 is the default one and always exists; switching only swaps
+// the table that is evaluated, the others stay compiled.
+
+/// Returns the ID of the named set, declaring it if needed (-1 when full)
+long DeclareSet(const char *name);
+
+/// Makes a set the one that is evaluated (releasing all actions)
+bool Activate(long set);
+
+long Current();
+
+/// Configures the set a room switches to (-1 for none)
+bool Room(long room, long set);
+
+/// Whether any room switches sets (the room events are needed)
+bool Rooms();
+
+/// Room events: entering a configured room activates its set, leaving it
+/// restores the one before unless the script switched in between.
+void Enter(long room);
+void Leave();
+
+//------------------------------------------------------------------------------
+
+} /* namespace AGSJoyAction */
+
+#endif /* _ACTION_H */
+
+//..............................................................................
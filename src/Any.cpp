@@ -0,0 +1,218 @@
+/*************************************************************
+ * Device aggregate -- See header file for more information. *
+ *************************************************************/
+
+#include <string.h>
+
+#include <vector>
+
+#include "Any.h"
+#include "Clock.h"
+
+//------------------------------------------------------------------------------
+
+namespace AGSJoyAny {
+
+bool open = false;
+bool registered = false;          // Managed by the engine (until disposed)
+
+/// What is kept of a device between merges
+struct Slot
+{
+	AGSJoyMap::Pad pad;
+	int32_t axis[ANY_AXES];       // Its last state, for backends without timestamps
+	int32_t pov;
+	uint32_t buttons;
+	uint64_t stamp;               // Time that state changed
+};
+
+std::vector<Slot> slots;          // Maps joystick ID to its device
+int32_t deadzone = 0;
+int devices = 0;                  // Merged at the last merge
+State merged;
+uint64_t latched = 0;             // Time of the last merge
+uint64_t stamp = 0;               // Newest input of the merged devices
+
+//------------------------------------------------------------------------------
+
+inline int32_t Magnitude(int32_t value)
+{
+	return (value < 0) ? -value : value;
+}
+
+inline long Age(uint64_t since)
+{
+	if (!devices)
+		return 0;
+	
+	uint64_t age = AGSJoyClock::Now() - since;
+	return (age > 0x7FFFFFFF) ? 0x7FFFFFFF : (long) age;
+}
+
+//------------------------------------------------------------------------------
+
+bool Open()
+{
+	if (open)
+		return false;
+	
+	open = true;
+	memset(&merged, 0, sizeof (merged));
+	devices = 0;
+	return true;
+}
+
+//------------------------------------------------------------------------------
+
+bool Close()
+{
+	if (!open)
+		return false;
+	
+	open = false;
+	slots.clear();
+	memset(&merged, 0, sizeof (merged));
+	devices = 0;
+	return true;
+}
+
+//------------------------------------------------------------------------------
+
+bool Opened()
+{
+	return open;
+}
+
+//------------------------------------------------------------------------------
+
+bool Register()
+{
+	if (registered)
+		return false;
+	
+	registered = true;
+	return true;
+}
+
+//------------------------------------------------------------------------------
+
+void Dispose()
+{
+	registered = false;
+}
+
+//==============================================================================
+
+void Begin(int32_t dead)
+{
+	deadzone = dead;
+	devices = 0;
+	stamp = 0;
+	memset(&merged, 0, sizeof (merged));
+}
+
+//------------------------------------------------------------------------------
+
+void Add(int id, const Device &dev)
+{
+	if (id < 0)
+		return;
+	
+	if ((size_t) id >= slots.size())
+		slots.resize(id + 1);
+	
+	// A pad is attached on first sight (Apply follows new mappings)
+	Slot &slot = slots[id];
+	AGSJoyMap::Pad &pad = slot.pad;
+	if (!pad.generation || memcmp(pad.guid, dev.guid, sizeof (pad.guid)))
+	{
+		AGSJoyMap::Attach(pad, dev.guid);
+		slot.stamp = AGSJoyClock::Now();
+	}
+	
+	// Without a timestamp a change is stamped when it is merged
+	if (!dev.stamp && (memcmp(slot.axis, dev.axis, sizeof (slot.axis))
+	|| slot.pov != dev.pov || slot.buttons != dev.buttons))
+	{
+		memcpy(slot.axis, dev.axis, sizeof (slot.axis));
+		slot.pov = dev.pov;
+		slot.buttons = dev.buttons;
+		slot.stamp = AGSJoyClock::Now();
+	}
+	
+	devices++;
+	uint64_t input = dev.stamp ? dev.stamp : slot.stamp;
+	if (input > stamp)
+		stamp = input;
+	
+	if (dev.button_count > merged.button_count)
+		merged.button_count = dev.button_count;
+	if (dev.axis_count > merged.axis_count)
+		merged.axis_count = dev.axis_count;
+	
+	int32_t axis[ANY_AXES];
+	for (int a = 0; a < ANY_AXES; ++a)
+	{
+		axis[a] = dev.axis[a];
+		if ((axis[a] < deadzone) && (axis[a] > -deadzone))
+			axis[a] = 0;
+		if (Magnitude(axis[a]) > Magnitude(merged.axis[a]))
+			merged.axis[a] = axis[a];
+	}
+	
+	merged.buttons |= dev.buttons;
+	if (!merged.pov)
+		merged.pov = dev.pov;
+	
+	AGSJoyMap::Apply(pad, axis, dev.pov, dev.buttons);
+	if (!pad.mapping)
+		return;
+	
+	if (!merged.pad.mapping)
+		merged.pad.mapping = pad.mapping;
+	merged.pad.buttons |= pad.buttons;
+	for (int a = 0; a < AGSJoyMap::PAD_AXES; ++a)
+		if (Magnitude(pad.axis[a]) > Magnitude(merged.pad.axis[a]))
+			merged.pad.axis[a] = pad.axis[a];
+}
+
+//------------------------------------------------------------------------------
+
+void End()
+{
+	latched = AGSJoyClock::Now();
+}
+
+//==============================================================================
+
+const State &Merged()
+{
+	return merged;
+}
+
+//------------------------------------------------------------------------------
+
+bool Unplugged()
+{
+	return !devices;
+}
+
+//------------------------------------------------------------------------------
+
+long InputAge()
+{
+	return Age(latched);
+}
+
+//------------------------------------------------------------------------------
+
+long EventAge()
+{
+	return Age(stamp);
+}
+
+//------------------------------------------------------------------------------
+
+} /* namespace AGSJoyAny */
+
+//..............................................................................
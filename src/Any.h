@@ -0,0 +1,84 @@
+/*******************************************************
+ * Device aggregate -- header file                     *
+ *                                                     *
+ * Author: agent                                       *
+ *                                                     *
+ * Date: 23:10 19-10-2026                              *
+ *                                                     *
+ * Description: Merges the state of every device into  *
+ *              the one instance of Open(JOY_ANY).     *
+ *******************************************************/
+
+#ifndef _ANY_H
+#define _ANY_H
+
+#include <stdint.h>
+
+#include "Mapping.h"
+
+/// Device aggregate
+namespace AGSJoyAny {
+
+//------------------------------------------------------------------------------
+// The backends read their devices straight into a Device, there is no
+// instance per device: the aggregate is no open joystick of each of them.
+// Buttons and pad buttons are or-ed, every axis takes the largest deflection,
+// the pov and the mapping are those of the first device that has one.
+
+#define ANY_AXES 6
+
+/// One plugged in device, as its backend keeps it
+struct Device
+{
+	int32_t button_count;
+	int32_t axis_count;
+	int32_t axis[ANY_AXES];  // Calibrated, x-w
+	int32_t pov;
+	uint32_t buttons;
+	uint64_t stamp;          // Time of its newest input (0 when unknown)
+	const uint8_t *guid;     // Key of its mapping
+};
+
+/// Merged state, as the instance exposes it
+struct State
+{
+	int32_t button_count;
+	int32_t axis_count;
+	int32_t axis[ANY_AXES];
+	int32_t pov;
+	uint32_t buttons;
+	AGSJoyMap::Pad pad;      // Mapping of the first mapped device, all pads merged
+};
+
+//------------------------------------------------------------------------------
+
+bool Open();     ///< Opens the aggregate, false when it already was
+bool Close();    ///< Closes it, false when it was not open
+bool Opened();
+
+bool Register(); ///< The engine manages the instance from now on, false when it already did
+void Dispose();  ///< It no longer does
+
+//------------------------------------------------------------------------------
+
+/// Starts a merge, axes within the deadzone read as zero
+void Begin(int32_t deadzone);
+
+/// Merges one device (by joystick ID, which keeps its pad)
+void Add(int id, const Device &dev);
+
+/// Finishes the merge
+void End();
+
+const State &Merged();
+bool Unplugged(); ///< No device was plugged in at the last merge
+long InputAge();  ///< Since the last merge (microseconds, 0 without devices)
+long EventAge();  ///< Since the newest input of any device (idem)
+
+//------------------------------------------------------------------------------
+
+} /* namespace AGSJoyAny */
+
+#endif /* _ANY_H */
+
+//..............................................................................
@@ -0,0 +1,269 @@
+/**********************************************************
+ * Device cache -- See header file for more information. *
+ **********************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "Cache.h"
+#include "Serial.h"
+
+using AGSJoySerial::put16;
+using AGSJoySerial::put32;
+using AGSJoySerial::get16;
+using AGSJoySerial::get32;
+
+//------------------------------------------------------------------------------
+
+namespace AGSJoyCache {
+
+#define CACHE_FIELD 0xFFFF // Longest key, ident or data
+
+bool Store::load(const std::string &file)
+{
+	entries.clear();
+	path = file;
+	changed = false;
+	
+	if (path.empty())
+		return false;
+	
+	FILE *fp = fopen(path.c_str(), "rb");
+	if (!fp)
+		return false;
+	
+	std::string in;
+	char buffer[4096];
+	size_t size;
+	while ((size = fread(buffer, 1, sizeof (buffer), fp)) > 0)
+		in.append(buffer, size);
+	fclose(fp);
+	
+	if (in.size() < 8 || get32(in.data()) != CACHE_MAGIC || get16(in.data() + 4) != CACHE_VERSION)
+		return false;
+	
+	unsigned count = get16(in.data() + 6);
+	size_t pos = 8;
+	for (unsigned i = 0; i < count; ++i)
+	{
+		std::string field[3];
+		for (int j = 0; j < 3; ++j)
+		{
+			if (pos + 2 > in.size())
+				return !entries.empty();
+			size = get16(in.data() + pos);
+			if (pos + 2 + size > in.size())
+				return !entries.empty();
+			field[j].assign(in, pos + 2, size);
+			pos += 2 + size;
+		}
+		
+		Entry &entry = entries[field[0]];
+		entry.ident = field[1];
+		entry.data = field[2];
+	}
+	
+	return true;
+}
+
+//------------------------------------------------------------------------------
+
+bool Store::save()
+{
+	if (!changed || path.empty())
+		return false;
+	
+	char head[8] = { 0 };
+	put32(head, CACHE_MAGIC);
+	put16(head + 4, CACHE_VERSION);
+	
+	std::string out(head, sizeof (head));
+	uint32_t count = 0;
+	for (std::map<std::string, Entry>::const_iterator it = entries.begin(); it != entries.end(); ++it)
+	{
+		if (it->second.session)
+			continue;
+		
+		count++;
+		const std::string *field[3] = { &it->first, &it->second.ident, &it->second.data };
+		for (int j = 0; j < 3; ++j)
+		{
+			char size[2];
+			put16(size, (uint32_t) field[j]->size());
+			out.append(size, 2);
+			out.append(*field[j]);
+		}
+	}
+	put16(&out[6], count);
+	
+	// Written aside first, so a crash never leaves half a file behind
+	std::string temp = path + ".tmp";
+	FILE *fp = fopen(temp.c_str(), "wb");
+	if (!fp)
+		return false;
+	
+	bool written = fwrite(out.data(), 1, out.size(), fp) == out.size();
+	written = !fclose(fp) && written;
+	
+	#if defined(_WIN32) || defined(_WINDOWS_)
+	if (written)
+		remove(path.c_str()); // rename() does not replace on Windows
+	#endif
+	
+	if (!written || rename(temp.c_str(), path.c_str()))
+	{
+		remove(temp.c_str());
+		return false;
+	}
+	
+	changed = false;
+	return true;
+}
+
+//------------------------------------------------------------------------------
+
+void Store::clear()
+{
+	entries.clear();
+	path.clear();
+	changed = false;
+}
+
+//------------------------------------------------------------------------------
+
+const Entry *Store::find(const std::string &key, const std::string &ident) const
+{
+	std::map<std::string, Entry>::const_iterator it = entries.find(key);
+	if (it == entries.end() || it->second.ident != ident)
+		return NULL;
+	return &it->second;
+}
+
+const Entry *Store::find(const std::string &key) const
+{
+	std::map<std::string, Entry>::const_iterator it = entries.find(key);
+	return (it == entries.end()) ? NULL : &it->second;
+}
+
+//------------------------------------------------------------------------------
+
+void Store::put(const std::string &key, const std::string &ident, const std::string &data,
+	bool session)
+{
+	if (key.size() > CACHE_FIELD || ident.size() > CACHE_FIELD || data.size() > CACHE_FIELD)
+		return;
+	
+	std::map<std::string, Entry>::iterator it = entries.find(key);
+	bool saved = it != entries.end() && !it->second.session;
+	if (it == entries.end())
+		it = entries.insert(std::make_pair(key, Entry())).first;
+	
+	Entry &entry = it->second;
+	if (entry.ident == ident && entry.data == data && entry.session == session)
+		return;
+	
+	entry.ident = ident;
+	entry.data = data;
+	entry.session = session;
+	
+	// The file only changes when a saved entry does (or goes)
+	if (saved || !session)
+		changed = true;
+}
+
+//------------------------------------------------------------------------------
+
+std::string Path()
+{
+	if (const char *env = getenv(CACHE_ENV))
+		return env;
+	
+	#if defined(_WIN32) || defined(_WINDOWS_)
+	if (const char *local = getenv("LOCALAPPDATA"))
+		return std::string(local) + "\\agsjoy.cache";
+	#else
+	if (const char *xdg = getenv("XDG_CACHE_HOME"))
+		if (*xdg)
+			return std::string(xdg) + "/agsjoy.cache";
+	if (const char *home = getenv("HOME"))
+		return std::string(home) + "/.cache/agsjoy.cache";
+	#endif
+	
+	return std::string();
+}
+
+//==============================================================================
+
+void Writer::u16(uint32_t v)
+{
+	char p[2];
+	put16(p, v);
+	out.append(p, 2);
+}
+
+void Writer::u32(uint32_t v)
+{
+	char p[4];
+	put32(p, v);
+	out.append(p, 4);
+}
+
+void Writer::u64(uint64_t v)
+{
+	u32((uint32_t) v);
+	u32((uint32_t) (v >> 32));
+}
+
+void Writer::str(const std::string &s)
+{
+	u16((uint32_t) s.size());
+	out.append(s, 0, s.size() & CACHE_FIELD);
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t Reader::u16()
+{
+	if (!ok || pos + 2 > in.size())
+		return ok = false, 0;
+	pos += 2;
+	return get16(in.data() + pos - 2);
+}
+
+uint32_t Reader::u32()
+{
+	if (!ok || pos + 4 > in.size())
+		return ok = false, 0;
+	pos += 4;
+	return get32(in.data() + pos - 4);
+}
+
+uint64_t Reader::u64()
+{
+	uint64_t low = u32();
+	return low | ((uint64_t) u32() << 32);
+}
+
+std::string Reader::str()
+{
+	size_t size = u16();
+	if (!ok || pos + size > in.size())
+		return ok = false, std::string();
+	pos += size;
+	return in.substr(pos - size, size);
+}
+
+bool Reader::raw(void *p, size_t n)
+{
+	if (!ok || pos + n > in.size())
+		return ok = false;
+	in.copy((char *) p, n, pos);
+	pos += n;
+	return true;
+}
+
+//------------------------------------------------------------------------------
+
+} /* namespace AGSJoyCache */
+
+//..............................................................................
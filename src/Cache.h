@@ -0,0 +1,114 @@
+/*******************************************************
+ * Device cache -- header file                         *
+ *                                                     *
+ * Author: agent                                       *
+ *                                                     *
+ * Date: 18:10 19-10-2026                              *
+ *                                                     *
+ * Description: Persistent metadata of enumerated      *
+ *              devices, for warm startups.            *
+ *******************************************************/
+
+#ifndef _CACHE_H
+#define _CACHE_H
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+
+/// Device cache
+namespace AGSJoyCache {
+
+//------------------------------------------------------------------------------
+// File layout (all fields little-endian):
+//
+//   offset  size  field
+//        0     4  magic     'AGJC'
+//        4     2  version   CACHE_VERSION
+//        6     2  count     number of entries
+//        8        entries   count times:
+//                   2  key length, key     (device node or slot)
+//                   2  ident length, ident (cheap to confirm, e.g. device ids)
+//                   2  data length, data   (what the probe found)
+//
+// An entry with empty data is a node that is no (usable) joystick. What goes
+// in ident and data is up to the backend; a file of another version is
+// ignored as a whole. Session entries (a node that could not be opened right
+// now) are only kept in memory and never written.
+
+#define CACHE_MAGIC   0x434A4741UL // 'AGJC'
+#define CACHE_VERSION 1
+#define CACHE_ENV     "AGSJOY_CACHE" // Overrides the file, empty disables it
+
+struct Entry
+{
+	std::string ident;
+	std::string data;
+	bool session; // Not saved
+	
+	Entry() : session(false) {}
+};
+
+struct Store
+{
+	std::map<std::string, Entry> entries;
+	std::string path;
+	bool changed;
+	
+	Store() : changed(false) {}
+	
+	bool load(const std::string &file); ///< Replaces the entries, false if none
+	bool save();                        ///< Writes the file if anything changed
+	void clear();
+	
+	/// Returns the entry for key if its identity still matches (or NULL)
+	const Entry *find(const std::string &key, const std::string &ident) const;
+	
+	/// Returns the entry for key, whatever its identity (or NULL)
+	const Entry *find(const std::string &key) const;
+	
+	/// Adds or replaces (invalidates) the entry for key
+	void put(const std::string &key, const std::string &ident, const std::string &data,
+		bool session = false);
+};
+
+/// Default location: $AGSJOY_CACHE, or agsjoy.cache in the user cache directory
+std::string Path();
+
+//------------------------------------------------------------------------------
+// Helpers for backends to pack ident and data fields
+
+struct Writer
+{
+	std::string out;
+	
+	void u16(uint32_t v);
+	void u32(uint32_t v);
+	void u64(uint64_t v);
+	void str(const std::string &s);
+	void raw(const void *p, size_t n) { out.append((const char *) p, n); }
+};
+
+struct Reader
+{
+	const std::string &in;
+	size_t pos;
+	bool ok; // False once a read went past the end
+	
+	Reader(const std::string &s) : in(s), pos(0), ok(true) {}
+	
+	uint32_t u16();
+	uint32_t u32();
+	uint64_t u64();
+	std::string str();
+	bool raw(void *p, size_t n);
+};
+
+//------------------------------------------------------------------------------
+
+} /* namespace AGSJoyCache */
+
+#endif /* _CACHE_H */
+
+//..............................................................................
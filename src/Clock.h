@@ -0,0 +1,75 @@
+/*******************************************************
+ * Monotonic clock -- header file                      *
+ *                                                     *
+ * Author: agent                                       *
+ *                                                     *
+ * Date: 11:05 19-10-2026                              *
+ *                                                     *
+ * Description: Platform independent monotonic time    *
+ *              in microseconds.                       *
+ *******************************************************/
+
+#ifndef _CLOCK_H
+#define _CLOCK_H
+
+#include <stdint.h>
+
+#if defined(_WIN32) || defined(_WINDOWS_)
+#	ifndef WIN32_LEAN_AND_MEAN
+#		define WIN32_LEAN_AND_MEAN
+#	endif
+#	include <windows.h>
+#else
+#	include <time.h>
+#endif
+
+/// Monotonic clock
+namespace AGSJoyClock {
+
+//------------------------------------------------------------------------------
+
+/// Returns the current monotonic time in microseconds
+inline uint64_t Now()
+{
+#if defined(_WIN32) || defined(_WINDOWS_)
+	static LARGE_INTEGER freq = { 0 };
+	LARGE_INTEGER count;
+	if (!freq.QuadPart)
+		QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&count);
+	return (uint64_t) (count.QuadPart / freq.QuadPart) * 1000000
+	     + (uint64_t) (count.QuadPart % freq.QuadPart) * 1000000 / freq.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+//------------------------------------------------------------------------------
+
+/// Returns the current monotonic time in nanoseconds (for short intervals)
+inline uint64_t Ticks()
+{
+#if defined(_WIN32) || defined(_WINDOWS_)
+	static LARGE_INTEGER freq = { 0 };
+	LARGE_INTEGER count;
+	if (!freq.QuadPart)
+		QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&count);
+	return (uint64_t) (count.QuadPart / freq.QuadPart) * 1000000000
+	     + (uint64_t) (count.QuadPart % freq.QuadPart) * 1000000000 / freq.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+//------------------------------------------------------------------------------
+
+} /* namespace AGSJoyClock */
+
+#endif /* _CLOCK_H */
+
+//..............................................................................
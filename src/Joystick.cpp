@@ -39,6 +39,7 @@ namespace AGSJOYSTICK {
 void Initialize() {}
 void Update() {}
 void Terminate() {}
+bool Background(bool enable) { return false; }
 
 // Manager
 int AGSJoystick::Dispose(const char *address, bool force) { return 1; }
@@ -65,6 +66,11 @@ long Joystick_IsButtonDown(Joystick *, long button) { return 0; }
 void Joystick_Update(Joystick *) {}
 void Joystick_EnableEvents(Joystick *, long scope) {}
 void Joystick_DisableEvents(Joystick *) {}
+void Joystick_SetDeadzone(Joystick *, long deadzone) {}
+void Joystick_SetThreshold(Joystick *, long threshold) {}
+void Joystick_SetEventMask(Joystick *, long mask) {}
+long Joystick_GetInputAge(Joystick *) { return 0; }
+long Joystick_GetEventAge(Joystick *) { return 0; }
 
 //------------------------------------------------------------------------------
 
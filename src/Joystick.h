@@ -11,7 +11,19 @@
 
 #ifndef _JOYSTICK_H
 
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <set>
+#include <vector>
+
 #include "API.h"
+#include "Mapping.h"
+#include "Action.h"
+#include "Snapshot.h"
+#include "Serial.h"
+#include "Any.h"
 
 #ifndef AGSJOYSTICK
 #	ifdef WIN_AUTO_VERSION
@@ -24,6 +36,12 @@
 #	endif
 #endif
 
+// Plugin (see agsplugin.cpp)
+long JoystickSetSampling(long mode);
+void JoystickActive(bool open); ///< Called as joystick instances come and go
+long JoystickAddMappings(const char *mappings);
+long JoystickRoomActionSet(long room, long set);
+
 /// Joystick plugin
 namespace AGSJOYSTICK {
 
@@ -32,6 +50,7 @@ namespace AGSJOYSTICK {
 void Initialize(); ///< Initializes the interface so it is ready to be used
 void Update();     ///< Updates the interface state
 void Terminate();  ///< Resets the interface to its initial state
+bool Background(bool enable); ///< Starts or stops the background reader (false when unsupported)
 
 //------------------------------------------------------------------------------
 
@@ -42,18 +61,29 @@ struct JoyState;
 struct Joystick
 {
 	// Exposed: <<<DO NOT CHANGE THE ORDER!!!>>>
-	long id;
-	long button_count;
-	long axis_count;
-	long x, y, z, u, v, w;
-	long pov;
-	unsigned long buttons;
+	// Read by scripts as readonly int fields, so these must stay 32 bits wide.
+	int32_t id;
+	int32_t button_count;
+	int32_t axis_count;
+	int32_t x, y, z, u, v, w;
+	int32_t pov;
+	uint32_t buttons;
 	
 	// Internal:
-	int events;
 	JoyState *state;
+	int32_t events;     // Event scope (0 = off, 1 = room, 2 = global)
+	int32_t deadzone;   // Axis values within this range read as zero
+	int32_t threshold;  // Minimal axis change that triggers a move event
+	uint32_t mask;      // Enabled event types (JOY_EVENT_*)
+	AGSJoyMap::Pad pad; // Standardized layout, when the controller is known
 };
 
+#define JOY_EXPOSED_SIZE (11 * 4)
+
+static_assert(offsetof(Joystick, x) == 12, "Joystick: exposed layout changed");
+static_assert(offsetof(Joystick, buttons) == 40, "Joystick: exposed layout changed");
+static_assert(offsetof(Joystick, state) >= JOY_EXPOSED_SIZE, "Joystick: exposed layout changed");
+
 AGS_DEFINE_CLASS(Joystick)
 
 //------------------------------------------------------------------------------
@@ -78,6 +108,194 @@ long Joystick_IsButtonDown(Joystick *, long button);
 void Joystick_Update(Joystick *);
 void Joystick_EnableEvents(Joystick *, long scope);
 void Joystick_DisableEvents(Joystick *);
+void Joystick_SetDeadzone(Joystick *, long deadzone);
+void Joystick_SetThreshold(Joystick *, long threshold);
+void Joystick_SetEventMask(Joystick *, long mask);
+long Joystick_GetInputAge(Joystick *);
+long Joystick_GetEventAge(Joystick *);
+
+// Mapped (the same for every backend, which keep pad up to date)
+inline long Joystick_IsMapped(Joystick *joy)
+{
+	return joy->pad.mapping ? 1 : 0;
+}
+
+inline long Joystick_IsPadButtonDown(Joystick *joy, long button)
+{
+	if ((button < 0) || (button >= AGSJoyMap::PAD_BUTTONS))
+		return 0;
+	return (joy->pad.buttons >> button) & 1;
+}
+
+inline long Joystick_GetPadAxis(Joystick *joy, long axis)
+{
+	if ((axis < 0) || (axis >= AGSJoyMap::PAD_AXES))
+		return 0;
+	return joy->pad.axis[axis];
+}
+
+// Snapshot (one call for everything, the script then only reads fields)
+using AGSJoySnapshot::JoystickState;
+using AGSJoySnapshot::agsJoystickState;
+
+inline JoystickState *Joystick_GetState(Joystick *joy, JoystickState *state)
+{
+	if (!state)
+		state = AGSJoySnapshot::Create();
+	
+	state->id = joy->id;
+	state->x = joy->x; state->y = joy->y; state->z = joy->z;
+	state->u = joy->u; state->v = joy->v; state->w = joy->w;
+	state->pov = joy->pov;
+	state->buttons = joy->buttons;
+	state->pad_buttons = joy->pad.buttons;
+	memcpy(state->pad_axis, joy->pad.axis, sizeof (state->pad_axis));
+	state->mapped = joy->pad.mapping ? 1 : 0;
+	state->input_age = Joystick_GetInputAge(joy);
+	return state;
+}
+
+// Actions (static, evaluated by the backends at the end of every update)
+inline long Joystick_Action(const char *name)
+{
+	return AGSJoyAction::Declare(name);
+}
+
+inline long Joystick_BindAction(long action, long id, long type, long index, long threshold, long value, long set)
+{
+	return AGSJoyAction::Bind(set, action, id, type, index, threshold, value) ? 1 : 0;
+}
+
+inline void Joystick_UnbindAction(long action, long set)
+{
+	AGSJoyAction::Unbind(set, action);
+}
+
+inline long Joystick_IsActionDown(long action)
+{
+	return AGSJoyAction::Down(action) ? 1 : 0;
+}
+
+inline long Joystick_GetActionValue(long action)
+{
+	return AGSJoyAction::Value(action);
+}
+
+inline long Joystick_ActionSet(const char *name)
+{
+	return AGSJoyAction::DeclareSet(name);
+}
+
+inline long Joystick_SetActionSet(long set)
+{
+	return AGSJoyAction::Activate(set) ? 1 : 0;
+}
+
+inline long Joystick_GetActionSet()
+{
+	return AGSJoyAction::Current();
+}
+
+/// Evaluates the actions against the open joysticks in one pass
+inline void Joystick_actions(const std::set<Joystick *> &joyset)
+{
+	if (!AGSJoyAction::Active())
+		return;
+	
+	AGSJoyAction::Source sources[ACTION_JOYSTICKS];
+	memset(sources, 0, sizeof (sources));
+	
+	std::set<Joystick *>::const_iterator it;
+	for (it = joyset.begin(); it != joyset.end(); ++it)
+	{
+		Joystick *joy = *it;
+		if ((joy->id < 0) || (joy->id >= ACTION_JOYSTICKS))
+			continue;
+		
+		AGSJoyAction::Source &s = sources[joy->id];
+		s.present = true;
+		s.word[0] = joy->buttons;
+		s.word[1] = (uint32_t) joy->pov;
+		s.word[2] = joy->pad.buttons;
+		s.axis[0] = &joy->x;
+		s.axis[1] = joy->pad.axis;
+	}
+	
+	AGSJoyAction::Evaluate(sources);
+}
+
+//------------------------------------------------------------------------------
+// Aggregate of all devices (Open(JOY_ANY), see Any.h). Every backend has one
+// instance for it, outside of joyset, that Joystick_any() merges its devices
+// into after the update. It counts as an open joystick, so the updates go on
+// (and find plugged in devices) while there are none.
+
+/// Merges the devices into the aggregate, or lets go of what it read them
+/// with once it closed (every backend but the stubs)
+void Joystick_any(Joystick &joy);
+
+/// Copies the last merge into the instance
+inline void Joystick_anycopy(Joystick &joy)
+{
+	const AGSJoyAny::State &merged = AGSJoyAny::Merged();
+	joy.button_count = merged.button_count;
+	joy.axis_count = merged.axis_count;
+	memcpy(&joy.x, merged.axis, sizeof (merged.axis)); // x-w are consecutive
+	joy.pov = merged.pov;
+	joy.buttons = merged.buttons;
+	joy.pad = merged.pad;
+}
+
+inline void Joystick_anyopen(Joystick &joy)
+{
+	if (!AGSJoyAny::Open())
+		return;
+	
+	memset(&joy, 0, sizeof (Joystick));
+	joy.id = JOY_ANY;
+	joy.threshold = JOY_THRESHOLD;
+	joy.mask = JOY_EVENT_ALL;
+	JoystickActive(true);
+	Joystick_any(joy);
+}
+
+inline void Joystick_anyclose(Joystick &joy)
+{
+	if (!AGSJoyAny::Close())
+		return;
+	
+	memset(&joy, 0, sizeof (Joystick));
+	joy.id = INVALID_JOY;
+	JoystickActive(false);
+	Joystick_any(joy);
+}
+
+/// Open(JOY_ANY): the instance is handed to the engine once
+inline Joystick *Joystick_anyobject(Joystick &joy)
+{
+	Joystick_anyopen(joy);
+	if (AGSJoyAny::Register())
+		AGS_OBJECT(Joystick, &joy);
+	return &joy;
+}
+
+/// A saved aggregate is restored whatever devices there are now
+inline void Joystick_anyrestore(Joystick &joy, const AGSJoySerial::Record &serial, int key)
+{
+	Joystick_anyopen(joy);
+	joy.deadzone = serial.deadzone;
+	joy.threshold = serial.threshold;
+	joy.mask = serial.mask;
+	AGSJoyAny::Register();
+	AGS_RESTORE(Joystick, &joy, key);
+}
+
+/// Disposed (or terminated): closed, the engine no longer has it
+inline void Joystick_anydispose(Joystick &joy)
+{
+	Joystick_anyclose(joy);
+	AGSJoyAny::Dispose();
+}
 
 //------------------------------------------------------------------------------
 
@@ -94,6 +312,20 @@ void Joystick_DisableEvents(Joystick *);
 	"/// Returns the name of the specified gamecontroller. (0-15)\r\n" \
 	"import String JoystickName (int ID);\r\n" \
 	"\r\n" \
+	"enum JoystickSampling {\r\n" \
+	"	eJoySamplePrerender = 1,\r\n" \
+	"	eJoySampleFinalDraw = 2,\r\n" \
+	"	eJoySampleBoth = 3,\r\n" \
+	"	eJoySampleLatest = 4\r\n" \
+	"};\r\n" \
+	"\r\n" \
+	"/// Sets when controllers are sampled. Returns false when the mode is unsupported.\r\n" \
+	"import bool JoystickSetSampling (JoystickSampling mode);\r\n" \
+	"/// Adds controller mappings (gamecontrollerdb.txt lines). Returns how many were added.\r\n" \
+	"import int JoystickAddMappings (String mappings);\r\n" \
+	"/// Activates an action set whenever the room is entered, until it is left. (-1 for none)\r\n" \
+	"import bool JoystickRoomActionSet (int room, int set);\r\n" \
+	"\r\n" \
 	"enum JoystickPOV {\r\n" \
 	"	ePOVCenter = 0,\r\n" \
 	"	ePOVUp = 1,\r\n" \
@@ -106,7 +338,75 @@ void Joystick_DisableEvents(Joystick *);
 	"	ePOVDownLeft = 12\r\n" \
 	"};\r\n" \
 	"\r\n" \
+	"enum JoystickEvent {\r\n" \
+	"	eJoyEventMove = 1,\r\n" \
+	"	eJoyEventPress = 2,\r\n" \
+	"	eJoyEventPOV = 4,\r\n" \
+	"	eJoyEventAll = 7\r\n" \
+	"};\r\n" \
+	"\r\n" \
+	"enum JoystickPadButton {\r\n" \
+	"	eJoyPadA = 0,\r\n" \
+	"	eJoyPadB = 1,\r\n" \
+	"	eJoyPadX = 2,\r\n" \
+	"	eJoyPadY = 3,\r\n" \
+	"	eJoyPadBack = 4,\r\n" \
+	"	eJoyPadGuide = 5,\r\n" \
+	"	eJoyPadStart = 6,\r\n" \
+	"	eJoyPadLeftStick = 7,\r\n" \
+	"	eJoyPadRightStick = 8,\r\n" \
+	"	eJoyPadLeftShoulder = 9,\r\n" \
+	"	eJoyPadRightShoulder = 10,\r\n" \
+	"	eJoyPadUp = 11,\r\n" \
+	"	eJoyPadDown = 12,\r\n" \
+	"	eJoyPadLeft = 13,\r\n" \
+	"	eJoyPadRight = 14\r\n" \
+	"};\r\n" \
+	"\r\n" \
+	"enum JoystickPadAxis {\r\n" \
+	"	eJoyPadLeftX = 0,\r\n" \
+	"	eJoyPadLeftY = 1,\r\n" \
+	"	eJoyPadRightX = 2,\r\n" \
+	"	eJoyPadRightY = 3,\r\n" \
+	"	eJoyPadTriggerLeft = 4,\r\n" \
+	"	eJoyPadTriggerRight = 5\r\n" \
+	"};\r\n" \
+	"\r\n" \
+	"enum JoystickBind {\r\n" \
+	"	eJoyBindButton = 1,\r\n" \
+	"	eJoyBindButtons = 2,\r\n" \
+	"	eJoyBindPOV = 3,\r\n" \
+	"	eJoyBindPadButton = 4,\r\n" \
+	"	eJoyBindAxis = 5,\r\n" \
+	"	eJoyBindAxisPositive = 6,\r\n" \
+	"	eJoyBindAxisNegative = 7,\r\n" \
+	"	eJoyBindPadAxis = 8,\r\n" \
+	"	eJoyBindPadAxisPositive = 9,\r\n" \
+	"	eJoyBindPadAxisNegative = 10\r\n" \
+	"};\r\n" \
+	"\r\n" \
 	"#define JOY_RANGE 32768\r\n" \
+	"#define JOY_ANY -3\r\n" \
+	"managed struct JoystickState {\r\n" \
+	"	readonly int ID;\r\n" \
+	"	readonly int x;\r\n" \
+	"	readonly int y;\r\n" \
+	"	readonly int z;\r\n" \
+	"	readonly int u;\r\n" \
+	"	readonly int v;\r\n" \
+	"	readonly int w;\r\n" \
+	"	readonly JoystickPOV POV;\r\n" \
+	"/// Raw buttons, bit n is button n.\r\n" \
+	"	readonly int Buttons;\r\n" \
+	"/// Standard gamepad buttons, bit n is JoystickPadButton n.\r\n" \
+	"	readonly int PadButtons;\r\n" \
+	"/// Standard gamepad axes, indexed by JoystickPadAxis.\r\n" \
+	"	readonly int PadAxis[6];\r\n" \
+	"	readonly bool Mapped;\r\n" \
+	"/// How old the state was when taken. (microseconds)\r\n" \
+	"	readonly int InputAge;\r\n" \
+	"};\r\n" \
+	"\r\n" \
 	"managed struct Joystick {\r\n" \
 	"	readonly int ID;\r\n" \
 	"	readonly int ButtonCount;\r\n" \
@@ -120,12 +420,28 @@ void Joystick_DisableEvents(Joystick *);
 	"	readonly JoystickPOV POV;\r\n" \
 	"	readonly int buttons; // $AUTOCOMPLETEIGNORE$\r\n" \
 	"	\r\n" \
-	"/// Opens specified controller. (0-15)\r\n" \
+	"/// Opens specified controller. (0-15, JOY_ANY for all of them merged into one)\r\n" \
 	"	import static Joystick* Open (int ID); // $AUTOCOMPLETESTATICONLY$\r\n" \
 	"/// Checks if specified controller has been opened. (0-15)\r\n" \
 	"	import static bool IsOpen (int ID); // $AUTOCOMPLETESTATICONLY$\r\n" \
 	"/// Simulates a mouseclick at the current cursor position.\r\n" \
 	"	import static void Click (MouseButton button);\r\n" \
+	"/// Returns the ID of the named action, declaring it when new. (-1 when there are too many)\r\n" \
+	"	import static int Action (String name); // $AUTOCOMPLETESTATICONLY$\r\n" \
+	"/// Binds an input of a controller to an action. Index is a button, axis, POV or mask.\r\n" \
+	"	import static bool BindAction (int action, int ID, JoystickBind type, int index, int threshold = 16384, int value = 32767, int set = 0); // $AUTOCOMPLETESTATICONLY$\r\n" \
+	"/// Removes all bindings of an action from an action set.\r\n" \
+	"	import static void UnbindAction (int action, int set = 0); // $AUTOCOMPLETESTATICONLY$\r\n" \
+	"/// Returns true while any input bound to the action is down. (controllers must be open)\r\n" \
+	"	import static bool IsActionDown (int action); // $AUTOCOMPLETESTATICONLY$\r\n" \
+	"/// Returns the strongest push up minus the strongest push down of the action's inputs.\r\n" \
+	"	import static int GetActionValue (int action); // $AUTOCOMPLETESTATICONLY$\r\n" \
+	"/// Returns the ID of the named action set, declaring it when new. (set 0 is the default)\r\n" \
+	"	import static int ActionSet (String name); // $AUTOCOMPLETESTATICONLY$\r\n" \
+	"/// Switches the action set whose bindings are evaluated. Releases all actions.\r\n" \
+	"	import static bool SetActionSet (int set); // $AUTOCOMPLETESTATICONLY$\r\n" \
+	"/// Returns the active action set.\r\n" \
+	"	import static int GetActionSet (); // $AUTOCOMPLETESTATICONLY$\r\n" \
 	"/// Closes controller.\r\n" \
 	"	import void Close ();\r\n" \
 	"/// Returns whether the controller is valid. (use this when loading save games)\r\n" \
@@ -144,6 +460,24 @@ void Joystick_DisableEvents(Joystick *);
 	"	import void EnableEvents (int scope = 0);\r\n" \
 	"/// Disable events. (disabled by default)\r\n" \
 	"	import void DisableEvents ();\r\n" \
+	"/// Sets the axis deadzone; smaller deflections read as zero. (0-32768)\r\n" \
+	"	import void SetDeadzone (int deadzone);\r\n" \
+	"/// Sets the minimal axis change that triggers on_joy_move. (default 256)\r\n" \
+	"	import void SetThreshold (int threshold);\r\n" \
+	"/// Selects which events are raised when enabled. (default eJoyEventAll)\r\n" \
+	"	import void SetEventMask (JoystickEvent mask);\r\n" \
+	"/// Returns how old the current axis, button and pov state is. (microseconds)\r\n" \
+	"	import int GetInputAge ();\r\n" \
+	"/// Returns the time since the most recent input of the controller. (microseconds)\r\n" \
+	"	import int GetEventAge ();\r\n" \
+	"/// Returns true when the controller's layout is known (see JoystickAddMappings).\r\n" \
+	"	import bool IsMapped ();\r\n" \
+	"/// Returns true when the button at the standard gamepad position is down.\r\n" \
+	"	import bool IsPadButtonDown (JoystickPadButton button);\r\n" \
+	"/// Returns a standard gamepad axis. (triggers 0-32767)\r\n" \
+	"	import int GetPadAxis (JoystickPadAxis axis);\r\n" \
+	"/// Returns the whole controller state in one call. Pass a previous one to refill it.\r\n" \
+	"	import JoystickState* GetState (JoystickState* state = 0);\r\n" \
 	"};\r\n";
 #endif
 
@@ -152,10 +486,22 @@ void Joystick_DisableEvents(Joystick *);
 	AGS_FUNCTION(JoystickCount)                  \
 	AGS_FUNCTION(JoystickRescan)                 \
 	AGS_FUNCTION(JoystickName)                   \
+	AGS_FUNCTION(JoystickSetSampling)            \
+	AGS_FUNCTION(JoystickAddMappings)            \
+	AGS_FUNCTION(JoystickRoomActionSet)          \
 	AGS_CLASS   (Joystick)                       \
+	AGS_CLASS   (JoystickState)                  \
 	AGS_METHOD  (Joystick, Open, 1)              \
 	AGS_METHOD  (Joystick, IsOpen, 1)            \
 	AGS_METHOD  (Joystick, Click, 1)             \
+	AGS_METHOD  (Joystick, Action, 1)            \
+	AGS_METHOD  (Joystick, BindAction, 7)        \
+	AGS_METHOD  (Joystick, UnbindAction, 2)      \
+	AGS_METHOD  (Joystick, IsActionDown, 1)      \
+	AGS_METHOD  (Joystick, GetActionValue, 1)    \
+	AGS_METHOD  (Joystick, ActionSet, 1)         \
+	AGS_METHOD  (Joystick, SetActionSet, 1)      \
+	AGS_METHOD  (Joystick, GetActionSet, 0)      \
 	AGS_METHOD  (Joystick, Close, 0)             \
 	AGS_METHOD  (Joystick, Valid, 0)             \
 	AGS_METHOD  (Joystick, Unplugged, 0)         \
@@ -164,7 +510,16 @@ void Joystick_DisableEvents(Joystick *);
 	AGS_METHOD  (Joystick, IsButtonDown, 1)      \
 	AGS_METHOD  (Joystick, Update, 0)            \
 	AGS_METHOD  (Joystick, EnableEvents, 1)      \
-	AGS_METHOD  (Joystick, DisableEvents, 0)
+	AGS_METHOD  (Joystick, DisableEvents, 0)     \
+	AGS_METHOD  (Joystick, SetDeadzone, 1)       \
+	AGS_METHOD  (Joystick, SetThreshold, 1)      \
+	AGS_METHOD  (Joystick, SetEventMask, 1)      \
+	AGS_METHOD  (Joystick, GetInputAge, 0)       \
+	AGS_METHOD  (Joystick, GetEventAge, 0)       \
+	AGS_METHOD  (Joystick, IsMapped, 0)          \
+	AGS_METHOD  (Joystick, IsPadButtonDown, 1)   \
+	AGS_METHOD  (Joystick, GetPadAxis, 1)        \
+	AGS_METHOD  (Joystick, GetState, 1)
 #endif
 
 //------------------------------------------------------------------------------
@@ -34,6 +34,13 @@ void Terminate()
 {
 }
 
+//------------------------------------------------------------------------------
+
+bool Background(bool enable)
+{
+	return false;
+}
+
 //==============================================================================
 
 int AGSJoystick::Dispose(const char *address, bool force)
@@ -156,6 +163,38 @@ void Joystick_DisableEvents(Joystick *)
 
 //------------------------------------------------------------------------------
 
+void Joystick_SetDeadzone(Joystick *, long deadzone)
+{
+}
+
+//------------------------------------------------------------------------------
+
+void Joystick_SetThreshold(Joystick *, long threshold)
+{
+}
+
+//------------------------------------------------------------------------------
+
+void Joystick_SetEventMask(Joystick *, long mask)
+{
+}
+
+//------------------------------------------------------------------------------
+
+long Joystick_GetInputAge(Joystick *)
+{
+	return 0;
+}
+
+//------------------------------------------------------------------------------
+
+long Joystick_GetEventAge(Joystick *)
+{
+	return 0;
+}
+
+//------------------------------------------------------------------------------
+
 } /* namespace AGSJoystick */
 
 //..............................................................................
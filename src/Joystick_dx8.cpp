@@ -38,6 +38,13 @@ void Terminate()
 {
 }
 
+//------------------------------------------------------------------------------
+
+bool Background(bool enable)
+{
+	return false;
+}
+
 //==============================================================================
 
 int AGSJoystick::Dispose(const char *address, bool force)
@@ -160,6 +167,38 @@ void Joystick_DisableEvents(Joystick *)
 
 //------------------------------------------------------------------------------
 
+void Joystick_SetDeadzone(Joystick *, long deadzone)
+{
+}
+
+//------------------------------------------------------------------------------
+
+void Joystick_SetThreshold(Joystick *, long threshold)
+{
+}
+
+//------------------------------------------------------------------------------
+
+void Joystick_SetEventMask(Joystick *, long mask)
+{
+}
+
+//------------------------------------------------------------------------------
+
+long Joystick_GetInputAge(Joystick *)
+{
+	return 0;
+}
+
+//------------------------------------------------------------------------------
+
+long Joystick_GetEventAge(Joystick *)
+{
+	return 0;
+}
+
+//------------------------------------------------------------------------------
+
 } /* namespace AGSJoystick(DX8) */
 
 //..............................................................................
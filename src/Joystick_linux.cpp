@@ -1,45 +1,419 @@
 /***********************************************************
  * Joystick interface -- platform specific implementation  *
  *                                                         *
- * Author:                                                 *
+ * Author: Ferry "Wyz" Timmers                             *
  *                                                         *
- * Date:                                                   *
+ * Date: 11:30 19-10-2026                                  *
  *                                                         *
- * Description: Joystick interface ? version.              *
+ * Description: Joystick interface Linux version, reads    *
+ *              the evdev devices (/dev/input/event*).     *
  ***********************************************************/
 
-#include <stdio.h> // debug
-
 #include "Joystick.h"
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <poll.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <linux/input.h>
+
+#include <vector>
+#include <set>
+#include <string>
+#include <algorithm>
+#include <atomic>
+
+#include "version.h"
+#include "Serial.h"
+#include "Clock.h"
+#include "Stats.h"
+#include "Trace.h"
+#include "Probes.h"
+#include "Profile.h"
+#include "Schedule.h"
+#include "Ring.h"
+#include "Scan.h"
+#include "Cache.h"
+
+// Older kernel headers only have the timeval member
+#ifndef input_event_sec
+#	define input_event_sec time.tv_sec
+#	define input_event_usec time.tv_usec
+#endif
+
 namespace AGSJoystick {
 
 using namespace AGSJoyAPI;
 
+//==============================================================================
+
+#define JOY_AXES    6
+#define JOY_BUTTONS 32
+#define JOY_NODES   "/dev/input"
+#define JOY_BATCH   64 // Events read at once
+#define JOY_RING    64 // Reads in flight (one per device)
+
+struct JoyState;
+struct JoyDevice;
+struct Joystick;
+
+int count = 0;                  // Number of joysticks found
+std::vector<JoyDevice *> map;   // Maps joystick ID to device
+std::set<Joystick *> joyset;    // Keep opened joysticks
+Joystick dummy;                 // Fake joystick for fallback behaviour
+Joystick aggregate;             // All devices merged (JOY_ANY, see Any.h)
+
+std::atomic<bool> reading(false); // Background reader is running
+std::atomic<bool> running(false); // Signals the reader to keep going
+std::atomic<bool> plugged(false); // Device nodes appeared since the last scan
+pthread_t reader;
+int epoll = -1;                 // Reader: waits on the descriptors below
+int wakeup = -1;                // Reader: eventfd to resync or stop it
+int notify = -1;                // Reader: inotify on the device directory
+AGSJoyRing::Ring ring;          // Batched reads when not using the reader
+AGSJoyScan::Job scan;           // Enumerates the devices at startup
+AGSJoyCache::Store cache;       // What earlier scans found, by node (see Cache.h)
+bool repost = false;            // Ring: devices may need a read posted
+bool merging = false;           // The aggregate is open (devlock), all devices are read
+pthread_mutex_t devlock = PTHREAD_MUTEX_INITIALIZER; // Guards map, refs and fds (before JoyDevice::lock)
+
+// Invariant I: map.size() == count
+// Invariant II: joy.id != INVALID_JOY <=> joy.state != NULL
+// Invariant III: joy.id != INVALID_JOY => map[joy.id] exists
+// Invariant IV: JoyDevice::refs == number of states referring to the device
+
+// Private methods
+inline Joystick *Joystick_find(long index); // Find an open joystick instance (or NULL)
+Joystick *Joystick_create(long index); // Create a new joystick instance
+void Joystick_release(Joystick *);     // Releases the device of an instance
+void Joystick_update(Joystick *);      // Update axes, button and pov state
+inline bool Joystick_wanted(const JoyDevice *); // Read for an instance or the aggregate
+void Joystick_process(Joystick *);     // Process events (when enabled)
+JoyDevice *Joystick_probe(const char *node, const AGSJoyCache::Entry *cached = NULL,
+	std::string *ident = NULL, bool *rejected = NULL);
+std::string Joystick_ident(int fd);    // Cache identity of an opened device
+std::string Joystick_describe(const JoyDevice *); // Cache data of a device
+bool Joystick_restore(JoyDevice *, const std::string &data);
+void Joystick_read(JoyDevice *);       // Reads all pending device events
+void Joystick_parse(JoyDevice *, const struct input_event *, size_t n);
+void Joystick_unplug(JoyDevice *);     // Marks a device as gone
+bool Joystick_unplugged(JoyDevice *);  // Reads that mark, safe while the reader runs
+void Joystick_resync(JoyDevice *);     // Queries the full state after a drop
+void Joystick_uring(bool enable);      // Switches batched reads on or off
+void Joystick_reap();                  // Handles ring completions, posts reads
+int Joystick_complete();               // Handles ring completions only
+void Joystick_scan(std::vector<std::string> &nodes);
+void Joystick_probeall(const std::vector<std::string> &nodes, std::vector<JoyDevice *> &devs);
+void Joystick_enumerate();             // Runs the startup scan
+inline void Joystick_ready() { scan.wait(); } // Waits for the startup scan
+void *Joystick_reader(void *);
+void Joystick_wake();                  // Wakes idle devices that have events
+void Joystick_notify();                // Has the reader pick up device changes
+
+//------------------------------------------------------------------------------
+
+/// Physical device, shared by all instances that opened it
+struct JoyDevice
+{
+	std::string node;             // Device node path
+	std::string name;             // Device name
+	int index;                    // Joystick ID
+	uint32_t ident;               // Device hash before collision handling
+	uint32_t hash;                // Unique device hash
+	uint8_t guid[16];             // SDL style GUID, the key of its mapping
+	int fd;
+	int refs;                     // Number of open instances
+	bool unplugged;
+	bool monotonic;               // Event timestamps use the monotonic clock
+
+	int axis_count;
+	int button_count;
+	signed char axis[ABS_CNT];    // Maps an ABS code to an axis slot (or -1)
+	signed char button[KEY_CNT];  // Maps a KEY code to a button index (or -1)
+	int32_t min[JOY_AXES];        // Used for calibration
+	float scale[JOY_AXES];        // idem
+
+	// Live state (guarded by lock while the background reader runs)
+	pthread_mutex_t lock;
+	int32_t value[JOY_AXES];      // Raw axis values
+	int32_t hatx, haty;
+	uint32_t buttons;
+	uint64_t stamp;               // Timestamp of the newest event
+	uint32_t dirty;               // Axes (0-5) and hats (6-7) changed since sampled
+	uint32_t pressed;             // Buttons changed since sampled
+	bool dropped;                 // Events were lost, skipping to the next report
+
+	// Ring reads (only touched by the thread that updates)
+	bool posted;                  // A read is in flight
+	bool blocking;                // fd was switched to blocking mode
+	struct input_event batch[JOY_BATCH]; // Buffer of the read in flight
+
+	JoyDevice() : index(INVALID_JOY), fd(-1), refs(0), unplugged(false), monotonic(false),
+		axis_count(0), button_count(0), hatx(0), haty(0), buttons(0), stamp(0),
+		dirty(0), pressed(0), dropped(false), posted(false), blocking(false)
+	{
+		memset(axis, -1, sizeof (axis));
+		memset(button, -1, sizeof (button));
+		memset(min, 0, sizeof (min));
+		memset(scale, 0, sizeof (scale));
+		memset(value, 0, sizeof (value));
+		memset(guid, 0, sizeof (guid));
+		pthread_mutex_init(&lock, NULL);
+	}
+
+	~JoyDevice()
+	{
+		if (fd >= 0)
+			close(fd);
+		pthread_mutex_destroy(&lock);
+	}
+
+	inline int32_t calibrate(int slot) const
+	{
+		if (slot >= axis_count)
+			return 0;
+		return (int32_t) ((value[slot] - min[slot]) * scale[slot]) - 32768;
+	}
+
+	inline int32_t pov() const
+	{
+		int32_t bits = 0;
+		if (hatx < 0)
+			bits |= 8; /* Left */
+		else if (hatx > 0)
+			bits |= 2; /* Right */
+
+		if (haty > 0)
+			bits |= 4; /* Down */
+		else if (haty < 0)
+			bits |= 1; /* Up */
+		return bits;
+	}
+};
+
 //------------------------------------------------------------------------------
 
+struct JoyState
+{
+	JoyDevice *dev;
+	int32_t x, y, z, u, v, w;     // Used to store the last axis states
+	int32_t pov;                  // Used to store the last pov state
+	uint32_t buttons;             // Used to store the last button states
+	uint64_t latched;             // Time the joystick state was last read
+	uint64_t stamp;               // Timestamp of the newest event in that state
+	AGSJoySchedule::Poll schedule; // Backs off reading while idle
+
+	JoyState (JoyDevice *device) : dev(device), buttons(0), latched(0), stamp(0)
+	{
+		pthread_mutex_lock(&devlock);
+		dev->refs++;
+		pthread_mutex_unlock(&devlock);
+		Joystick_notify();
+		AGSJoyStats::open.add();
+		JoystickActive(true);
+	}
+
+	~JoyState()
+	{
+		pthread_mutex_lock(&devlock);
+		dev->refs--;
+		pthread_mutex_unlock(&devlock);
+		Joystick_notify();
+		AGSJoyStats::open.sub();
+		JoystickActive(false);
+	}
+
+	void update(Joystick *joy)
+	{
+		x = joy->x; y = joy->y; z = joy->z;
+		u = joy->u; v = joy->v; w = joy->w;
+		pov = joy->pov;
+		buttons = joy->buttons;
+	}
+};
+
 //==============================================================================
 
 void Initialize()
 {
+	// Opening devices can take a while, so this does not hold up the
+	// engine; the first call that needs the device list waits for it instead.
+	// Lazy builds only scan then, games that never use a controller don't.
+	#ifdef JOY_LAZY
+	scan.defer(Joystick_enumerate);
+	#else
+	scan.start(Joystick_enumerate);
+	#endif
+
+	// Set up fake joystick instance
+	memset(&dummy, 0, sizeof (Joystick));
+	dummy.id = INVALID_JOY;
+
+	// Reads are batched when the kernel supports it (falls back otherwise)
+	Joystick_uring(true);
 }
 
 //------------------------------------------------------------------------------
 
 void Update()
 {
+	// Nothing can be open before the scan is done
+	if (!scan.done())
+		return;
+
+	// Batched reads cost one system call for all devices
+	if (ring.opened())
+		Joystick_reap();
+
+	// Otherwise idle devices are read less often (see Schedule.h); the
+	// kernel buffers their events in the meantime.
+	else if (!reading)
+		Joystick_wake();
+
+	std::set<Joystick *>::iterator it;
+	for (it = joyset.begin(); it != joyset.end(); ++it)
+	{
+		Joystick *joy = *it;
+		if (joy->id == INVALID_JOY)
+			continue;
+
+		JoyState &s = *joy->state;
+		if (!reading && !ring.opened() && !s.schedule.due())
+		{
+			AGSJoyStats::skipped.add();
+			continue;
+		}
+
+		uint64_t stamp = s.stamp;
+		Joystick_update(joy);
+		s.schedule.polled(s.stamp != stamp);
+		Joystick_process(joy);
+	}
+
+	// Skipped devices still hold their last state
+	Joystick_any(aggregate);
+	Joystick_actions(joyset);
 }
 
 //------------------------------------------------------------------------------
 
 void Terminate()
 {
+	scan.finish(); // A deferred scan is dropped
+	AGSJoyScan::Join();
+	Joystick_anydispose(aggregate);
+	Background(false);
+	Joystick_uring(false);
+
+	std::set<Joystick *>::iterator it;
+	for (it = joyset.begin(); it != joyset.end(); ++it)
+		Joystick_release(*it);
+	joyset.clear();
+
+	for (size_t i = 0; i < map.size(); ++i)
+		delete map[i];
+	map.clear();
+	cache.clear();
+	count = 0;
+}
+
+//------------------------------------------------------------------------------
+
+bool Background(bool enable)
+{
+	if (enable == reading)
+		return true;
+
+	if (enable)
+	{
+		// The reader reads the devices itself
+		Joystick_uring(false);
+
+		epoll = epoll_create1(EPOLL_CLOEXEC);
+		wakeup = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+		struct epoll_event ev;
+		ev.events = EPOLLIN;
+		ev.data.ptr = NULL;
+		if (epoll >= 0 && wakeup >= 0 && !epoll_ctl(epoll, EPOLL_CTL_ADD, wakeup, &ev))
+		{
+			// Hotplug is optional: without it every rescan reads the directory
+			notify = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+			ev.data.ptr = &notify;
+			if (notify >= 0
+			&& (inotify_add_watch(notify, JOY_NODES, IN_CREATE | IN_ATTRIB) < 0
+			|| epoll_ctl(epoll, EPOLL_CTL_ADD, notify, &ev) < 0))
+			{
+				close(notify);
+				notify = -1;
+			}
+
+			// Nodes may have appeared before the watch was set up
+			plugged = true;
+
+			running = true;
+			reading = !pthread_create(&reader, NULL, Joystick_reader, NULL);
+			running = reading.load();
+		}
+	}
+	else
+	{
+		// The reader sleeps until something happens, so wake it to stop
+		running = false;
+		Joystick_notify();
+		pthread_join(reader, NULL);
+		reading = false;
+	}
+
+	if (!reading)
+	{
+		if (notify >= 0)
+			close(notify);
+		if (wakeup >= 0)
+			close(wakeup);
+		if (epoll >= 0)
+			close(epoll);
+		epoll = wakeup = notify = -1;
+
+		Joystick_uring(true);
+	}
+
+	return reading == enable;
 }
 
 //==============================================================================
 
-int AGSJoystick::Dispose(const char *address, bool force)
+int AGSJoystick::Dispose(const char *address, bool /*force*/)
 {
+	Joystick *joy = (Joystick *)address;
+
+	// Never delete the fake joystick instance
+	if (joy == &dummy)
+		return 1;
+
+	// Nor the aggregate, it is only closed
+	if (joy == &aggregate)
+	{
+		Joystick_anydispose(aggregate);
+		return 1;
+	}
+
+	joyset.erase(joy);
+
+	TRACE(TRACE_DELETED, joy->id, (intptr_t) joy);
+	Joystick_release(joy);
+	delete joy;
+
 	return 1;
 }
 
@@ -47,47 +421,235 @@ int AGSJoystick::Dispose(const char *address, bool force)
 
 int AGSJoystick::Serialize(const char *address, char *buffer, int bufsize)
 {
-	return 0;
+	Joystick *joy = (Joystick *)address;
+
+	if (joy->id == INVALID_JOY)
+		return 0;
+
+	AGSJoySerial::Record serial;
+	serial.hash = (joy->id == JOY_ANY) ? RECORD_ANY : map[joy->id]->hash;
+	serial.events = joy->events;
+	serial.deadzone = joy->deadzone;
+	serial.threshold = joy->threshold;
+	serial.mask = joy->mask;
+
+	PROBE2(save, joy->id, serial.hash);
+	return AGSJoySerial::Write(serial, buffer, bufsize);
 }
 
 //------------------------------------------------------------------------------
 
 void AGSJoystick::Unserialize(int key, const char *serializedData, int dataSize)
 {
+	AGSJoySerial::Record serial = { 0, 0, 0, JOY_THRESHOLD, JOY_EVENT_ALL };
+	Joystick_ready();
+	if (!AGSJoySerial::Read(serial, serializedData, dataSize))
+	{
+		// Savefile incompatible, damaged or a fake joy
+		AGS_RESTORE(Joystick, &dummy, key);
+		return;
+	}
+
+	if (serial.hash == RECORD_ANY)
+	{
+		Joystick_anyrestore(aggregate, serial, key);
+		return;
+	}
+
+	// Find previous used device
+	for (int i = 0; i < count; ++i)
+	{
+		if (serial.hash == map[i]->hash) // Found
+		{
+			// We do not return already open instances since this would probably
+			// cause problems with AGS' garbage collector.
+			// Simply create a new instance always
+			Joystick *joy = Joystick_create(i);
+			TRACE(TRACE_RESTORED, joy->id, (intptr_t) joy);
+			PROBE2(restore, joy->id, serial.hash);
+			joy->events = serial.events;
+			joy->deadzone = serial.deadzone;
+			joy->threshold = serial.threshold;
+			joy->mask = serial.mask;
+			joyset.insert(joy);
+
+			AGS_RESTORE(Joystick, joy, key);
+			return;
+		}
+	}
+
+	// Device no longer present, invalidate joystick
+	PROBE2(restore, INVALID_JOY, serial.hash);
+	AGS_RESTORE(Joystick, &dummy, key);
 }
 
 //==============================================================================
 
 long JoystickCount()
 {
-	return 0;
+	Joystick_ready();
+	return count;
 }
 
 //------------------------------------------------------------------------------
 
 long JoystickRescan()
 {
-	return 0;
+	// While the reader watches the device directory a rescan without new
+	// nodes would find nothing.
+	if (notify >= 0 && !plugged)
+		return 0;
+	plugged = false;
+
+	Joystick_ready();
+	PROFILE(STAGE_ENUMERATE);
+	long found = false;
+
+	std::vector<std::string> nodes, fresh;
+	Joystick_scan(nodes);
+
+	for (size_t i = 0; i < nodes.size(); ++i)
+	{
+		// Skip nodes that are held by a working device
+		bool known = false;
+		for (int j = 0; j < count; ++j)
+			if (!Joystick_unplugged(map[j]) && map[j]->node == nodes[i])
+				known = true;
+		if (!known)
+			fresh.push_back(nodes[i]);
+	}
+
+	std::vector<JoyDevice *> devs;
+	Joystick_probeall(fresh, devs);
+	cache.save();
+
+	for (size_t i = 0; i < devs.size(); ++i)
+	{
+		JoyDevice *dev = devs[i];
+
+		// A device that was unplugged and came back keeps its old id
+		int j;
+		for (j = 0; j < count; ++j)
+			if (Joystick_unplugged(map[j]) && map[j]->ident == dev->ident)
+				break;
+
+		if (j < count)
+		{
+			// The reader registers descriptors under devlock and reads them
+			// under the device lock, so the swap holds both
+			JoyDevice *old = map[j];
+			pthread_mutex_lock(&devlock);
+			pthread_mutex_lock(&old->lock);
+			std::swap(old->fd, dev->fd);
+			old->node = dev->node;
+			memcpy(old->value, dev->value, sizeof (old->value));
+			old->hatx = dev->hatx;
+			old->haty = dev->haty;
+			old->buttons = dev->buttons;
+			old->monotonic = dev->monotonic;
+			old->stamp = dev->stamp;
+			old->unplugged = false;
+			old->posted = old->blocking = false;
+			pthread_mutex_unlock(&old->lock);
+			pthread_mutex_unlock(&devlock);
+			delete dev;
+			Joystick_notify();
+			AGSJoyStats::hotplug.add();
+			PROBE1(hotplug__add, j);
+			found = true;
+			continue;
+		}
+
+		// Check for collisions (two devices with the same name and id)
+		for (j = 0; j < count; ++j)
+			if (map[j]->hash == dev->hash)
+				dev->hash++;
+
+		// New (working) device found
+		pthread_mutex_lock(&devlock);
+		dev->index = count;
+		map.push_back(dev);
+		count++;
+		pthread_mutex_unlock(&devlock);
+		if (merging)
+			Joystick_notify(); // The aggregate reads it
+		AGSJoyStats::hotplug.add();
+		PROBE1(hotplug__add, dev->index);
+		found = true;
+	}
+
+	return found ? 1 : 0;
 }
 
 //------------------------------------------------------------------------------
 
 const char *JoystickName(long index)
 {
-	return "";
+	// Debug information (undocumented)
+	if (index == JOY_DEBUG_VERSION)
+		return AGS_STRING(ring.opened()
+			? PRODUCT_NAME " v" FILE_VERSION " evdev io_uring"
+			: PRODUCT_NAME " v" FILE_VERSION " evdev");
+	if (index == JOY_DEBUG_TRACE)
+	{
+		AGSJoyTrace::Dump();
+		return AGS_STRING("");
+	}
+	if (index <= JOY_DEBUG_LATENCY)
+		return AGS_STRING(AGSJoyStats::Report(index));
+
+	Joystick_ready();
+	if ((index < 0) || (index >= count))
+		return AGS_STRING("");
+
+	return AGS_STRING(map[index]->name.c_str());
 }
 
 //==============================================================================
 
 Joystick *Joystick_Open(long index)
 {
-	return NULL;
+	if (index == INVALID_JOY) // User requests a fake joystick instance
+	{
+		AGS_OBJECT(Joystick, &dummy);
+		return &dummy;
+	}
+
+	// The aggregate walks the devices too, so it waits for the scan as well
+	Joystick_ready();
+	if (index == JOY_ANY) // One instance for all devices (see Any.h)
+		return Joystick_anyobject(aggregate);
+
+	if ((index < 0) || (index >= count))
+		engine->AbortGame("!JoystickOpen: No device exists for specified index.");
+
+	Joystick *joy;
+
+	// Check if there is already an open instance, if so return it
+	if ((joy = Joystick_find(index)))
+		return joy;
+
+	// Create a new joystick instance
+	joy = Joystick_create(index);
+	TRACE(TRACE_CREATED, joy->id, (intptr_t) joy);
+
+	AGS_OBJECT(Joystick, joy);
+	joyset.insert(joy);
+	return joy;
 }
 
 //------------------------------------------------------------------------------
 
 long Joystick_IsOpen(long index)
 {
+	if (index == JOY_ANY)
+		return AGSJoyAny::Opened() ? 1 : 0;
+
+	std::set<Joystick *>::iterator it;
+	for (it = joyset.begin(); it != joyset.end(); ++it)
+		if ((*it)->id == index)
+			return 1;
+
 	return 0;
 }
 
@@ -95,69 +657,1217 @@ long Joystick_IsOpen(long index)
 
 void Joystick_Click(long button)
 {
+	engine->SimulateMouseClick(button);
 }
 
 //==============================================================================
 
-void Joystick_Close(Joystick *)
+void Joystick_Close(Joystick *joy)
 {
+	joyset.erase(joy);
+	if (joy == &aggregate)
+	{
+		Joystick_anyclose(aggregate);
+		return;
+	}
+
+	if (!joy || joy->id == INVALID_JOY)
+		return;
+
+	Joystick_release(joy);
+
+	memset(joy, 0, sizeof (Joystick));
+	joy->id = INVALID_JOY;
 }
 
 //------------------------------------------------------------------------------
 
-long Joystick_Valid(Joystick *)
+long Joystick_Valid(Joystick *joy)
 {
-	return 0;
+	if (!joy || joy->id == INVALID_JOY)
+		return 0;
+
+	return 1;
 }
 
 //------------------------------------------------------------------------------
 
-long Joystick_Unplugged(Joystick *)
+long Joystick_Unplugged(Joystick *joy)
 {
-	return 1;
+	if (!joy || joy->id == INVALID_JOY)
+		return 0;
+
+	if (joy->id == JOY_ANY)
+		return AGSJoyAny::Unplugged() ? 1 : 0;
+
+	return Joystick_unplugged(map[joy->id]) ? 1 : 0;
 }
 
 //------------------------------------------------------------------------------
 
-const char *Joystick_GetName(Joystick *)
+const char *Joystick_GetName(Joystick *joy)
 {
-	return "";
+	if (joy->id == INVALID_JOY || joy->id == JOY_ANY)
+		return AGS_STRING("");
+
+	return AGS_STRING(map[joy->id]->name.c_str());
 }
 
 //------------------------------------------------------------------------------
 
-long Joystick_GetAxis(Joystick *, long index)
+long Joystick_GetAxis(Joystick *joy, long index)
 {
-	return 0;
+	switch (index)
+	{
+		case 0: return (joy->x);
+		case 1: return (joy->y);
+		case 2: return (joy->z);
+		case 3: return (joy->u);
+		case 4: return (joy->v);
+		case 5: return (joy->w);
+		default:
+			engine->AbortGame("!GetAxis: No axis exists for specified index.");
+			return (0);
+	}
 }
 
 //------------------------------------------------------------------------------
 
-long Joystick_IsButtonDown(Joystick *, long button)
+long Joystick_IsButtonDown(Joystick *joy, long button)
 {
-	return 0;
+	return ((joy->buttons >> button) & 1);
+}
+
+//------------------------------------------------------------------------------
+
+void Joystick_Update(Joystick *joy)
+{
+	if (joy && joy->id == JOY_ANY)
+		Joystick_any(*joy);
+	else if (Joystick_Valid(joy))
+		Joystick_update(joy);
+}
+
+//------------------------------------------------------------------------------
+
+void Joystick_EnableEvents(Joystick *joy, long scope)
+{
+	// The aggregate has none, the devices' own instances raise them
+	if (!joy || joy->id == INVALID_JOY || joy->id == JOY_ANY)
+		return;
+
+	joy->state->update(joy);
+	joy->events = scope ? 1 : 2;
+}
+
+//------------------------------------------------------------------------------
+
+void Joystick_DisableEvents(Joystick *joy)
+{
+	if (!joy || joy->id == INVALID_JOY)
+		return;
+
+	joy->events = 0;
+}
+
+//------------------------------------------------------------------------------
+
+void Joystick_SetDeadzone(Joystick *joy, long deadzone)
+{
+	if (!joy || joy->id == INVALID_JOY)
+		return;
+
+	joy->deadzone = (deadzone < 0) ? 0 : deadzone;
+}
+
+//------------------------------------------------------------------------------
+
+void Joystick_SetThreshold(Joystick *joy, long threshold)
+{
+	if (!joy || joy->id == INVALID_JOY)
+		return;
+
+	joy->threshold = (threshold < 0) ? 0 : threshold;
+}
+
+//------------------------------------------------------------------------------
+
+void Joystick_SetEventMask(Joystick *joy, long mask)
+{
+	if (!joy || joy->id == INVALID_JOY)
+		return;
+
+	joy->mask = mask & JOY_EVENT_ALL;
+}
+
+//------------------------------------------------------------------------------
+
+long Joystick_GetInputAge(Joystick *joy)
+{
+	if (!joy || joy->id == INVALID_JOY)
+		return 0;
+
+	// The background reader keeps the device state current, so the age is
+	// only the time since it was copied into the script visible fields.
+	if (reading && joy->id == JOY_ANY)
+		Joystick_any(*joy);
+	else if (reading)
+		Joystick_update(joy);
+
+	if (joy->id == JOY_ANY)
+		return AGSJoyAny::InputAge();
+
+	uint64_t age = AGSJoyClock::Now() - joy->state->latched;
+	return (age > 0x7FFFFFFF) ? 0x7FFFFFFF : (long) age;
+}
+
+//------------------------------------------------------------------------------
+
+long Joystick_GetEventAge(Joystick *joy)
+{
+	if (!joy || joy->id == INVALID_JOY)
+		return 0;
+
+	if (reading && joy->id == JOY_ANY)
+		Joystick_any(*joy);
+	else if (reading)
+		Joystick_update(joy);
+
+	if (joy->id == JOY_ANY)
+		return AGSJoyAny::EventAge();
+
+	uint64_t age = AGSJoyClock::Now() - joy->state->stamp;
+	return (age > 0x7FFFFFFF) ? 0x7FFFFFFF : (long) age;
+}
+
+//==============================================================================
+
+inline Joystick *Joystick_find(long index)
+{
+	std::set<Joystick *>::iterator it;
+	for (it = joyset.begin(); it != joyset.end(); ++it)
+		if ((*it)->id == index)
+			return *it;
+
+	return NULL;
+}
+
+//------------------------------------------------------------------------------
+
+Joystick *Joystick_create(long index) // Pre: map[index] exists
+{
+	JoyDevice *dev = map[index];
+
+	Joystick *joy = new Joystick;
+	memset(joy, 0, sizeof (Joystick));
+
+	joy->id = index; // joystick id, not device index
+	joy->button_count = dev->button_count;
+	joy->axis_count = dev->axis_count;
+	joy->threshold = JOY_THRESHOLD;
+	joy->mask = JOY_EVENT_ALL;
+
+	joy->state = new JoyState(dev);
+	AGSJoyMap::Attach(joy->pad, dev->guid);
+	Joystick_update(joy);
+	joy->state->update(joy);
+
+	return joy;
+}
+
+//------------------------------------------------------------------------------
+
+void Joystick_release(Joystick *joy)
+{
+	if (joy->state)
+		delete joy->state;
+	joy->state = NULL;
+}
+
+//------------------------------------------------------------------------------
+
+void Joystick_update(Joystick *joy) // Pre: joy->id != INVALID_JOY
+{
+	JoyDevice &dev = *joy->state->dev;
+
+	if (reading)
+		pthread_mutex_lock(&dev.lock);
+	else
+	{
+		PROFILE(STAGE_READ);
+		if (ring.opened())
+			Joystick_reap();
+		else
+			Joystick_read(&dev);
+	}
+
+	{
+		PROFILE(STAGE_CALIBRATE);
+		joy->x = dev.calibrate(0); joy->y = dev.calibrate(1);
+		joy->z = dev.calibrate(2); joy->u = dev.calibrate(3);
+		joy->v = dev.calibrate(4); joy->w = dev.calibrate(5);
+	}
+	joy->buttons = dev.buttons;
+	joy->pov = dev.pov();
+	joy->state->stamp = dev.stamp;
+	dev.dirty = dev.pressed = 0;
+
+	if (reading)
+		pthread_mutex_unlock(&dev.lock);
+
+	joy->state->latched = AGSJoyClock::Now();
+
+	if (joy->deadzone)
+	{
+		PROFILE(STAGE_FILTER);
+		int32_t *axis[] = { &joy->x, &joy->y, &joy->z, &joy->u, &joy->v, &joy->w };
+		for (int i = 0; i < JOY_AXES; ++i)
+			if ((*axis[i] < joy->deadzone) && (*axis[i] > -joy->deadzone))
+				*axis[i] = 0;
+	}
+
+	AGSJoyMap::Apply(joy->pad, &joy->x, joy->pov, joy->buttons);
+}
+
+//------------------------------------------------------------------------------
+
+inline bool Joystick_wanted(const JoyDevice *dev) // Pre: devlock held or main thread
+{
+	return dev->refs || merging;
+}
+
+//------------------------------------------------------------------------------
+
+void Joystick_any(Joystick &joy)
+{
+	// Devices that no instance has open are read for the aggregate too
+	bool open = AGSJoyAny::Opened();
+	if (open != merging)
+	{
+		pthread_mutex_lock(&devlock);
+		merging = open;
+		pthread_mutex_unlock(&devlock);
+		Joystick_notify();
+	}
+
+	if (!open)
+		return;
+
+	// The update reads the devices of instances (or skips them while idle),
+	// the others are read here: the ones with events, found by one poll()
+	if (ring.opened())
+		Joystick_reap();
+	else if (!reading)
+	{
+		PROFILE(STAGE_READ);
+		std::vector<struct pollfd> fds;
+		std::vector<JoyDevice *> devs;
+		for (int i = 0; i < count; ++i)
+		{
+			if (map[i]->refs || map[i]->unplugged)
+				continue;
+
+			struct pollfd fd = { map[i]->fd, POLLIN, 0 };
+			fds.push_back(fd);
+			devs.push_back(map[i]);
+		}
+
+		if (!fds.empty() && poll(&fds[0], fds.size(), 0) > 0)
+			for (size_t i = 0; i < fds.size(); ++i)
+				if (fds[i].revents)
+					Joystick_read(devs[i]);
+	}
+
+	AGSJoyAny::Begin(joy.deadzone);
+	for (int i = 0; i < count; ++i)
+	{
+		JoyDevice &dev = *map[i];
+		AGSJoyAny::Device merged;
+
+		if (reading)
+			pthread_mutex_lock(&dev.lock);
+
+		bool plugged = !dev.unplugged;
+		merged.button_count = dev.button_count;
+		merged.axis_count = dev.axis_count;
+		for (int a = 0; a < JOY_AXES; ++a)
+			merged.axis[a] = dev.calibrate(a);
+		merged.pov = dev.pov();
+		merged.buttons = dev.buttons;
+		merged.stamp = dev.stamp;
+		merged.guid = dev.guid;
+
+		// Changes are sampled by the instances, nothing else samples these
+		if (!dev.refs)
+			dev.dirty = dev.pressed = 0;
+
+		if (reading)
+			pthread_mutex_unlock(&dev.lock);
+
+		if (plugged)
+			AGSJoyAny::Add(i, merged);
+	}
+	AGSJoyAny::End();
+
+	Joystick_anycopy(joy);
+}
+
+//------------------------------------------------------------------------------
+
+#define JOY_START_AXIS_CHECK { int change;
+#define JOY_AXIS_CHECK(a,i) change = joy->a - last->a; \
+	if ((change > joy->threshold) || (change < -joy->threshold)) axes |= 1 << i;
+#define JOY_END_AXIS_CHECK }
+
+#define JOY_EVENT(e,v) { \
+	engine->QueueGameScriptFunction(e, joy->events - 1, 2, (long) joy, v); \
+	AGSJoyStats::latency.add(AGSJoyClock::Now() - last->stamp); \
+	AGSJoyStats::queued.add(); \
+	PROBE3(queue, joy->id, e, v); }
+
+void Joystick_process(Joystick *joy) // Pre: joy->id != INVALID_JOY
+{
+	if (!joy->events)
+		return;
+
+	JoyState *&last = joy->state;
+	int axes = 0;
+	long pressed;
+	bool hat;
+
+	{
+		PROFILE(STAGE_DETECT);
+
+		JOY_START_AXIS_CHECK
+			JOY_AXIS_CHECK(x, 0)
+			JOY_AXIS_CHECK(y, 1)
+			JOY_AXIS_CHECK(z, 2)
+			JOY_AXIS_CHECK(u, 3)
+			JOY_AXIS_CHECK(v, 4)
+			JOY_AXIS_CHECK(w, 5)
+		JOY_END_AXIS_CHECK
+
+		pressed = joy->buttons ^ last->buttons;
+		hat = joy->pov != last->pov;
+
+		if (!(joy->mask & JOY_EVENT_MOVE))
+			axes = 0;
+		if (!(joy->mask & JOY_EVENT_PRESS))
+			pressed = 0;
+		if (!(joy->mask & JOY_EVENT_POV))
+			hat = false;
+	}
+
+	if (!(axes || pressed || hat))
+		return;
+
+	PROBE4(process, joy->id, axes, pressed, hat);
+	PROFILE(STAGE_DISPATCH);
+
+	last->update(joy);
+
+	{
+		int axis = 0;
+
+		while (axes)
+		{
+			if (axes & 1)
+				JOY_EVENT("on_joy_move", axis);
+
+			axes >>= 1;
+			axis++;
+		}
+	}
+
+	{
+		int button = 0;
+		pressed &= joy->buttons; // ignore button releases
+
+		while (pressed)
+		{
+			if (pressed & 1)
+				JOY_EVENT("on_joy_press", button);
+
+			pressed >>= 1;
+			button++;
+		}
+	}
+
+	if (hat)
+		JOY_EVENT("on_joy_pov", joy->pov);
+}
+
+//==============================================================================
+
+#define LONG_BITS (8 * sizeof (unsigned long))
+#define NBITS(x) (((x) + LONG_BITS - 1) / LONG_BITS)
+#define TEST_BIT(a,i) (((a)[(i) / LONG_BITS] >> ((i) % LONG_BITS)) & 1)
+
+JoyDevice *Joystick_probe(const char *node, const AGSJoyCache::Entry *cached,
+	std::string *ident, bool *rejected)
+{
+	int fd = open(node, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+	if (fd < 0)
+		return NULL;
+
+	// The node's entry only holds if the same device is behind it
+	std::string found = Joystick_ident(fd);
+	if (ident)
+		*ident = found;
+	if (cached && cached->ident != found)
+		cached = NULL;
+
+	// No joystick last time, none now
+	if (cached && cached->data.empty())
+	{
+		if (rejected)
+			*rejected = true;
+		close(fd);
+		return NULL;
+	}
+
+	// Have the kernel stamp events with the same clock we use
+	int clock = CLOCK_MONOTONIC;
+	bool monotonic = !ioctl(fd, EVIOCSCLOCKID, &clock);
+
+	// A device found before skips the capability queries, only its state
+	// is read (a stale entry falls through to the full probe)
+	if (cached)
+	{
+		JoyDevice *dev = new JoyDevice;
+		if (Joystick_restore(dev, cached->data))
+		{
+			dev->fd = fd;
+			dev->node = node;
+			dev->monotonic = monotonic;
+			Joystick_resync(dev);
+			dev->dirty = dev->pressed = 0;
+			dev->stamp = AGSJoyClock::Now();
+			return dev;
+		}
+		delete dev;
+	}
+
+	unsigned long evbits[NBITS(EV_CNT)] = { 0 };
+	unsigned long keybits[NBITS(KEY_CNT)] = { 0 };
+	unsigned long absbits[NBITS(ABS_CNT)] = { 0 };
+
+	if (ioctl(fd, EVIOCGBIT(0, sizeof (evbits)), evbits) < 0
+	|| ioctl(fd, EVIOCGBIT(EV_KEY, sizeof (keybits)), keybits) < 0
+	|| ioctl(fd, EVIOCGBIT(EV_ABS, sizeof (absbits)), absbits) < 0)
+	{
+		close(fd);
+		return NULL;
+	}
+
+	// A joystick has at least an X and Y axis and joystick or gamepad buttons
+	bool buttons = false;
+	for (int i = BTN_JOYSTICK; i < BTN_DIGI; ++i)
+		if (TEST_BIT(keybits, i))
+			buttons = true;
+
+	if (!TEST_BIT(evbits, EV_ABS) || !TEST_BIT(absbits, ABS_X)
+	|| !TEST_BIT(absbits, ABS_Y) || !buttons)
+	{
+		if (rejected)
+			*rejected = true;
+		close(fd);
+		return NULL;
+	}
+
+	JoyDevice *dev = new JoyDevice;
+	dev->fd = fd;
+	dev->node = node;
+	dev->monotonic = monotonic;
+	dev->stamp = AGSJoyClock::Now();
+
+	char name[128] = "Unknown joystick";
+	ioctl(fd, EVIOCGNAME(sizeof (name) - 1), name);
+	name[sizeof (name) - 1] = 0;
+	dev->name = name;
+
+	// Axes are assigned in code order (hats are reported as pov)
+	for (int i = 0; i < ABS_HAT0X && dev->axis_count < JOY_AXES; ++i)
+	{
+		struct input_absinfo info;
+		if (!TEST_BIT(absbits, i) || ioctl(fd, EVIOCGABS(i), &info) < 0)
+			continue;
+
+		int slot = dev->axis_count++;
+		dev->axis[i] = slot;
+		dev->min[slot] = info.minimum;
+		dev->scale[slot] = (info.maximum > info.minimum)
+			? 65535.0f / (info.maximum - info.minimum) : 0.0f;
+		dev->value[slot] = info.value;
+	}
+
+	struct input_absinfo hat;
+	if (TEST_BIT(absbits, ABS_HAT0X) && !ioctl(fd, EVIOCGABS(ABS_HAT0X), &hat))
+		dev->hatx = hat.value;
+	if (TEST_BIT(absbits, ABS_HAT0Y) && !ioctl(fd, EVIOCGABS(ABS_HAT0Y), &hat))
+		dev->haty = hat.value;
+
+	// Buttons are assigned joystick buttons first (same order as SDL)
+	unsigned long keystate[NBITS(KEY_CNT)] = { 0 };
+	ioctl(fd, EVIOCGKEY(sizeof (keystate)), keystate);
+
+	for (int i = BTN_JOYSTICK; i < KEY_CNT + BTN_JOYSTICK - BTN_MISC; ++i)
+	{
+		int code = (i < KEY_CNT) ? i : i - KEY_CNT + BTN_MISC;
+		if (!TEST_BIT(keybits, code) || dev->button_count >= JOY_BUTTONS)
+			continue;
+
+		int index = dev->button_count++;
+		dev->button[code] = index;
+		if (TEST_BIT(keystate, code))
+			dev->buttons |= 1UL << index;
+	}
+
+	// FNV-1a hash algorithm over the name and device id
+	static const uint32_t basis = 2166136261UL;
+	static const uint32_t prime = 16777619UL;
+
+	struct input_id id;
+	memset(&id, 0, sizeof (id));
+	ioctl(fd, EVIOCGID, &id);
+	AGSJoyMap::Guid(dev->guid, id.bustype, id.vendor, id.product, id.version, name);
+
+	uint32_t h = basis;
+	const unsigned char *ptr = (const unsigned char *) name;
+	while (*ptr)
+		h = (*ptr++ ^ h) * prime;
+
+	ptr = (const unsigned char *) &id;
+	for (size_t i = 0; i < sizeof (id); ++i)
+		h = (*ptr++ ^ h) * prime;
+
+	dev->ident = dev->hash = h;
+	return dev;
+}
+
+//------------------------------------------------------------------------------
+
+void Joystick_read(JoyDevice *dev) // Pre: dev->lock held or reader stopped
+{
+	if (dev->unplugged)
+		return;
+
+	struct input_event ev[JOY_BATCH];
+	ssize_t size;
+
+	while ((size = read(dev->fd, ev, sizeof (ev))) > 0)
+	{
+		Joystick_parse(dev, ev, size / sizeof (*ev));
+
+		if (size < (ssize_t) sizeof (ev))
+			break;
+	}
+
+	if (size < 0 && errno == ENODEV)
+		Joystick_unplug(dev);
+}
+
+//------------------------------------------------------------------------------
+
+void Joystick_parse(JoyDevice *dev, const struct input_event *ev, size_t n)
+{
+	AGSJoyStats::events.add(n);
+	PROBE2(read, dev->index, n);
+	if (n && dev->monotonic)
+		dev->stamp = (uint64_t) ev[n - 1].input_event_sec * 1000000
+		           + ev[n - 1].input_event_usec;
+	else if (n)
+		dev->stamp = AGSJoyClock::Now();
+
+	for (size_t i = 0; i < n; ++i)
+	{
+		// The kernel buffer overflowed: the events up to the next report are
+		// incomplete, after that the state is queried as a whole.
+		if (ev[i].type == EV_SYN)
+		{
+			if (ev[i].code == SYN_DROPPED)
+			{
+				TRACE(TRACE_DROPPED, dev->index);
+				AGSJoyStats::dropped.add();
+				dev->dropped = true;
+			}
+			else if (ev[i].code == SYN_REPORT && dev->dropped)
+			{
+				dev->dropped = false;
+				Joystick_resync(dev);
+			}
+			continue;
+		}
+
+		if (dev->dropped)
+			continue;
+
+		if (ev[i].type == EV_ABS)
+		{
+			int slot;
+			if (ev[i].code == ABS_HAT0X)
+				dev->hatx = ev[i].value, slot = 6;
+			else if (ev[i].code == ABS_HAT0Y)
+				dev->haty = ev[i].value, slot = 7;
+			else if (ev[i].code < ABS_CNT && dev->axis[ev[i].code] >= 0)
+			{
+				slot = dev->axis[ev[i].code];
+				dev->value[slot] = ev[i].value;
+			}
+			else
+				continue;
+
+			// A second change before sampling hides the first one
+			if (dev->dirty & (1 << slot))
+				AGSJoyStats::coalesced.add();
+			dev->dirty |= 1 << slot;
+		}
+		else if (ev[i].type == EV_KEY)
+		{
+			if (ev[i].code < KEY_CNT && dev->button[ev[i].code] >= 0)
+			{
+				uint32_t bit = 1UL << dev->button[ev[i].code];
+				if (ev[i].value == 2) // Autorepeat
+					continue;
+				if (dev->pressed & bit)
+					AGSJoyStats::coalesced.add();
+				dev->pressed |= bit;
+				if (ev[i].value)
+					dev->buttons |= bit;
+				else
+					dev->buttons &= ~bit;
+			}
+		}
+	}
+}
+
+//------------------------------------------------------------------------------
+
+void Joystick_unplug(JoyDevice *dev) // Pre: dev->lock held or reader stopped
+{
+	TRACE(TRACE_UNPLUGGED, dev->index);
+	dev->unplugged = true;
+	AGSJoyStats::hotplug.add();
+	PROBE1(hotplug__remove, dev->index);
 }
 
 //------------------------------------------------------------------------------
 
-void Joystick_Update(Joystick *)
+bool Joystick_unplugged(JoyDevice *dev)
 {
+	// The reader marks devices while holding their lock
+	pthread_mutex_lock(&dev->lock);
+	bool unplugged = dev->unplugged;
+	pthread_mutex_unlock(&dev->lock);
+	return unplugged;
 }
 
 //------------------------------------------------------------------------------
 
-void Joystick_EnableEvents(Joystick *, long scope)
+void Joystick_resync(JoyDevice *dev) // Pre: dev->lock held or reader stopped
 {
+	// Changes are marked like regular events, so the next update turns them
+	// into the edges that were lost (no stuck buttons).
+	bool changed = false;
+
+	unsigned long keystate[NBITS(KEY_CNT)] = { 0 };
+	if (ioctl(dev->fd, EVIOCGKEY(sizeof (keystate)), keystate) >= 0)
+	{
+		for (int code = 0; code < KEY_CNT; ++code)
+		{
+			if (dev->button[code] < 0)
+				continue;
+
+			uint32_t bit = 1UL << dev->button[code];
+			uint32_t down = TEST_BIT(keystate, code) ? bit : 0;
+			if ((dev->buttons & bit) == down)
+				continue;
+
+			dev->buttons ^= bit;
+			dev->pressed |= bit;
+			changed = true;
+		}
+	}
+
+	struct input_absinfo info;
+	for (int code = 0; code <= ABS_HAT0Y; ++code)
+	{
+		int slot = (code == ABS_HAT0X) ? 6 : (code == ABS_HAT0Y) ? 7 : dev->axis[code];
+		if (slot < 0 || ioctl(dev->fd, EVIOCGABS(code), &info) < 0)
+			continue;
+
+		int32_t &value = (slot == 6) ? dev->hatx : (slot == 7) ? dev->haty : dev->value[slot];
+		if (value == info.value)
+			continue;
+
+		value = info.value;
+		dev->dirty |= 1 << slot;
+		changed = true;
+	}
+
+	if (changed)
+		dev->stamp = AGSJoyClock::Now();
 }
 
 //------------------------------------------------------------------------------
 
-void Joystick_DisableEvents(Joystick *)
+inline bool Joystick_order(const std::string &a, const std::string &b)
 {
+	// Sort event nodes numerically (event2 before event10)
+	if (a.size() != b.size())
+		return a.size() < b.size();
+	return a < b;
+}
+
+void Joystick_scan(std::vector<std::string> &nodes)
+{
+	DIR *dir = opendir(JOY_NODES);
+	if (!dir)
+		return;
+
+	struct dirent *entry;
+	while ((entry = readdir(dir)))
+		if (!strncmp(entry->d_name, "event", 5))
+			nodes.push_back(std::string(JOY_NODES "/") + entry->d_name);
+
+	closedir(dir);
+	std::sort(nodes.begin(), nodes.end(), Joystick_order);
 }
 
 //------------------------------------------------------------------------------
 
+/// Probes one node on a worker thread
+struct JoyProbe : AGSJoyScan::Task
+{
+	std::string node;
+	std::string ident;            // Of the device found behind it
+	AGSJoyCache::Entry entry;     // What the cache had for the node
+	bool warm;
+	bool rejected;                // Opened, but it is no joystick
+	JoyDevice *dev;
+
+	JoyProbe(const std::string &path, const AGSJoyCache::Entry *cached)
+		: node(path), warm(cached != NULL), rejected(false), dev(NULL)
+	{
+		if (cached)
+			entry = *cached;
+	}
+
+	~JoyProbe() { delete dev; }
+	void run() { dev = Joystick_probe(node.c_str(), warm ? &entry : NULL, &ident, &rejected); }
+};
+
+void Joystick_probeall(const std::vector<std::string> &nodes, std::vector<JoyDevice *> &devs)
+{
+	// A node whose device did not change since it was probed last is only
+	// opened to confirm that: it is skipped if it was no joystick, and
+	// otherwise only has its state read
+	std::vector<AGSJoyScan::Task *> tasks;
+	for (size_t i = 0; i < nodes.size(); ++i)
+		tasks.push_back(new JoyProbe(nodes[i], cache.find(nodes[i])));
+
+	// A device that does not answer in time is skipped (until a rescan)
+	AGSJoyScan::Parallel(tasks);
+
+	for (size_t i = 0; i < tasks.size(); ++i)
+	{
+		JoyProbe *probe = (JoyProbe *) tasks[i];
+		if (!probe)
+			continue;
+
+		// Replaces the entry of a node that changed (or is new). A node that
+		// could not be opened (permissions, busy, out of descriptors) may
+		// work next time, so that is only remembered for this session.
+		if (probe->dev)
+			cache.put(probe->node, probe->ident, Joystick_describe(probe->dev));
+		else
+			cache.put(probe->node, probe->ident, std::string(), !probe->rejected);
+
+		if (probe->dev)
+			devs.push_back(probe->dev);
+		probe->dev = NULL;
+		delete probe;
+	}
+}
+
+//------------------------------------------------------------------------------
+
+/// Identity of the device behind a node: its ids, where it is plugged in and
+/// its serial. Unlike the node itself (devtmpfs recreates it every boot) these
+/// stay the same until another device takes its place.
+std::string Joystick_ident(int fd)
+{
+	struct input_id id;
+	memset(&id, 0, sizeof (id));
+	ioctl(fd, EVIOCGID, &id);
+
+	char phys[64] = "", uniq[64] = "";
+	ioctl(fd, EVIOCGPHYS(sizeof (phys) - 1), phys);
+	ioctl(fd, EVIOCGUNIQ(sizeof (uniq) - 1), uniq);
+
+	AGSJoyCache::Writer out;
+	out.u16(id.bustype);
+	out.u16(id.vendor);
+	out.u16(id.product);
+	out.u16(id.version);
+	out.str(phys);
+	out.str(uniq);
+	return out.out;
+}
+
+//------------------------------------------------------------------------------
+
+std::string Joystick_describe(const JoyDevice *dev)
+{
+	int axes[JOY_AXES], buttons[JOY_BUTTONS];
+	for (int code = 0; code < ABS_CNT; ++code)
+		if (dev->axis[code] >= 0)
+			axes[(int) dev->axis[code]] = code;
+	for (int code = 0; code < KEY_CNT; ++code)
+		if (dev->button[code] >= 0)
+			buttons[(int) dev->button[code]] = code;
+
+	AGSJoyCache::Writer out;
+	out.u32(dev->ident);
+	out.str(dev->name);
+
+	out.u16(dev->axis_count);
+	for (int slot = 0; slot < dev->axis_count; ++slot)
+	{
+		uint32_t scale;
+		memcpy(&scale, &dev->scale[slot], sizeof (scale));
+		out.u16(axes[slot]);
+		out.u32((uint32_t) dev->min[slot]);
+		out.u32(scale);
+	}
+
+	out.u16(dev->button_count);
+	for (int index = 0; index < dev->button_count; ++index)
+		out.u16(buttons[index]);
+
+	out.raw(dev->guid, sizeof (dev->guid));
+	return out.out;
+}
+
+//------------------------------------------------------------------------------
+
+bool Joystick_restore(JoyDevice *dev, const std::string &data)
+{
+	AGSJoyCache::Reader in(data);
+	uint32_t ident = in.u32();
+	std::string name = in.str();
+
+	int axis_count = in.u16();
+	if (!in.ok || axis_count > JOY_AXES)
+		return false;
+
+	int axes[JOY_AXES];
+	int32_t min[JOY_AXES];
+	float scale[JOY_AXES];
+	for (int slot = 0; slot < axis_count; ++slot)
+	{
+		uint32_t bits;
+		axes[slot] = in.u16();
+		min[slot] = (int32_t) in.u32();
+		bits = in.u32();
+		memcpy(&scale[slot], &bits, sizeof (bits));
+		if (axes[slot] >= ABS_HAT0X)
+			return false;
+	}
+
+	int button_count = in.u16();
+	if (!in.ok || button_count > JOY_BUTTONS)
+		return false;
+
+	int buttons[JOY_BUTTONS];
+	for (int index = 0; index < button_count; ++index)
+		if ((buttons[index] = in.u16()) >= KEY_CNT)
+			return false;
+
+	uint8_t guid[16];
+	in.raw(guid, sizeof (guid));
+	if (!in.ok || in.pos != data.size())
+		return false;
+
+	dev->ident = dev->hash = ident;
+	dev->name = name;
+	memcpy(dev->guid, guid, sizeof (guid));
+	dev->axis_count = axis_count;
+	for (int slot = 0; slot < axis_count; ++slot)
+	{
+		dev->axis[axes[slot]] = slot;
+		dev->min[slot] = min[slot];
+		dev->scale[slot] = scale[slot];
+	}
+	dev->button_count = button_count;
+	for (int index = 0; index < button_count; ++index)
+		dev->button[buttons[index]] = index;
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+
+void Joystick_enumerate()
+{
+	PROFILE(STAGE_ENUMERATE);
+	std::vector<std::string> nodes;
+	Joystick_scan(nodes);
+
+	std::vector<JoyDevice *> devs;
+	cache.load(AGSJoyCache::Path());
+	Joystick_probeall(nodes, devs);
+	cache.save();
+
+	// Detect devices
+	pthread_mutex_lock(&devlock);
+	for (size_t i = 0; i < devs.size(); ++i)
+	{
+		JoyDevice *dev = devs[i];
+
+		// Check for collisions (two devices with the same name and id)
+		for (int j = 0; j < count; ++j)
+			if (map[j]->hash == dev->hash)
+				dev->hash++;
+
+		dev->index = count;
+		map.push_back(dev);
+		++count;
+	}
+	pthread_mutex_unlock(&devlock);
+}
+
+//------------------------------------------------------------------------------
+
+void *Joystick_reader(void *)
+{
+	// Devices registered with epoll and the descriptor they were added with
+	std::vector<JoyDevice *> devs;
+	std::vector<int> fds;
+	struct epoll_event events[16];
+	bool sync = true;
+
+	while (running)
+	{
+		// Register devices that are wanted, drop the rest
+		if (sync)
+		{
+			pthread_mutex_lock(&devlock);
+
+			// Removals go first, a stale descriptor number may be reused
+			for (size_t j = devs.size(); j-- > 0;)
+			{
+				JoyDevice *dev = devs[j];
+				if (Joystick_wanted(dev) && !dev->unplugged && fds[j] == dev->fd)
+					continue;
+
+				// A closed descriptor already left the epoll set
+				epoll_ctl(epoll, EPOLL_CTL_DEL, fds[j], NULL);
+				devs.erase(devs.begin() + j);
+				fds.erase(fds.begin() + j);
+			}
+
+			for (size_t i = 0; i < map.size(); ++i)
+			{
+				JoyDevice *dev = map[i];
+				if (!Joystick_wanted(dev) || dev->unplugged
+				|| std::find(devs.begin(), devs.end(), dev) != devs.end())
+					continue;
+
+				struct epoll_event ev;
+				ev.events = EPOLLIN;
+				ev.data.ptr = dev;
+				if (!epoll_ctl(epoll, EPOLL_CTL_ADD, dev->fd, &ev))
+				{
+					devs.push_back(dev);
+					fds.push_back(dev->fd);
+				}
+			}
+			pthread_mutex_unlock(&devlock);
+			sync = false;
+		}
+
+		// Sleep until input arrives, no timeout
+		int n = epoll_wait(epoll, events, 16, -1);
+		if (n < 0 && errno != EINTR)
+			break;
+
+		for (int i = 0; i < n; ++i)
+		{
+			void *ptr = events[i].data.ptr;
+			if (!ptr) // Resync or stop
+			{
+				uint64_t value;
+				while (read(wakeup, &value, sizeof (value)) > 0);
+				sync = true;
+			}
+			else if (ptr == &notify) // Device nodes appeared
+			{
+				char buffer[4096];
+				while (read(notify, buffer, sizeof (buffer)) > 0);
+				plugged = true;
+			}
+			else
+			{
+				JoyDevice *dev = (JoyDevice *) ptr;
+				pthread_mutex_lock(&dev->lock);
+				Joystick_read(dev);
+				pthread_mutex_unlock(&dev->lock);
+
+				// An unplugged device would keep reporting an error
+				if (dev->unplugged)
+					sync = true;
+			}
+		}
+	}
+
+	return NULL;
+}
+
+//------------------------------------------------------------------------------
+
+void Joystick_notify()
+{
+	repost = true;
+	if (wakeup < 0)
+		return;
+
+	uint64_t one = 1;
+	if (write(wakeup, &one, sizeof (one)) < 0)
+		return; // Counter is full: a resync is pending anyway
+}
+
+//------------------------------------------------------------------------------
+
+void Joystick_wake() // Pre: reader stopped
+{
+	std::vector<struct pollfd> fds;
+	std::vector<JoyState *> states;
+
+	std::set<Joystick *>::iterator it;
+	for (it = joyset.begin(); it != joyset.end(); ++it)
+	{
+		Joystick *joy = *it;
+		if (joy->id == INVALID_JOY || !joy->state->schedule.idling())
+			continue;
+
+		struct pollfd fd = { joy->state->dev->fd, POLLIN, 0 };
+		fds.push_back(fd);
+		states.push_back(joy->state);
+	}
+
+	// One poll() over the idle devices tells which of them have events, so
+	// input on an idle pad is picked up on the next update, not its next slot.
+	if (fds.empty() || poll(&fds[0], fds.size(), 0) <= 0)
+		return;
+
+	for (size_t i = 0; i < fds.size(); ++i)
+		if (fds[i].revents)
+			states[i]->schedule.wake();
+}
+
+//------------------------------------------------------------------------------
+
+void Joystick_uring(bool enable)
+{
+	if (enable == ring.opened())
+		return;
+
+	if (enable)
+	{
+		repost = ring.open(JOY_RING);
+		return;
+	}
+
+	// The kernel writes into dev->batch until a read completes, so every read
+	// in flight is cancelled and collected (with what it got) before the ring
+	// and the devices can go away.
+	int flight = 0;
+	for (size_t i = 0; i < map.size(); ++i)
+	{
+		JoyDevice *dev = map[i];
+		if (!dev->posted)
+			continue;
+
+		while (!ring.cancel(dev) && ring.submit() > 0);
+		flight++;
+	}
+
+	while (flight > 0)
+	{
+		flight -= Joystick_complete();
+		if (flight > 0 && ring.submit(1) < 0)
+			break; // Ring broken, closing it is all that is left
+	}
+
+	ring.close();
+
+	// Direct reads must not block
+	for (size_t i = 0; i < map.size(); ++i)
+	{
+		JoyDevice *dev = map[i];
+		if (dev->blocking)
+			fcntl(dev->fd, F_SETFL, fcntl(dev->fd, F_GETFL) | O_NONBLOCK);
+		dev->posted = dev->blocking = false;
+	}
+}
+
+//------------------------------------------------------------------------------
+
+int Joystick_complete() // Pre: ring opened
+{
+	AGSJoyRing::Completion done[JOY_RING];
+	int n = ring.reap(done, JOY_RING);
+	int reads = 0;
+
+	for (int i = 0; i < n; ++i)
+	{
+		JoyDevice *dev = (JoyDevice *) done[i].data;
+		if (!dev) // A cancel
+			continue;
+
+		dev->posted = false;
+		reads++;
+
+		if (done[i].result > 0)
+			Joystick_parse(dev, dev->batch, done[i].result / sizeof (struct input_event));
+		else if (done[i].result == -ENODEV)
+			Joystick_unplug(dev);
+	}
+
+	return reads;
+}
+
+//------------------------------------------------------------------------------
+
+void Joystick_reap() // Pre: ring opened
+{
+	if (!Joystick_complete() && !repost)
+		return;
+	repost = false;
+
+	// Keep a read in flight on every device that is wanted
+	for (size_t i = 0; i < map.size(); ++i)
+	{
+		JoyDevice *dev = map[i];
+		if (dev->posted || dev->unplugged || !Joystick_wanted(dev))
+			continue;
+
+		// io_uring answers reads on non-blocking files with -EAGAIN
+		if (!dev->blocking)
+		{
+			fcntl(dev->fd, F_SETFL, fcntl(dev->fd, F_GETFL) & ~O_NONBLOCK);
+			dev->blocking = true;
+		}
+
+		dev->posted = ring.read(dev->fd, dev->batch, sizeof (dev->batch), dev);
+	}
+
+	ring.submit();
+}
+
+//==============================================================================
+
 } /* namespace AGSJoystick */
 
 //..............................................................................
@@ -21,8 +21,18 @@
 
 #include <vector>
 #include <set>
+#include <string>
 
 #include "version.h"
+#include "Serial.h"
+#include "Clock.h"
+#include "Stats.h"
+#include "Trace.h"
+#include "Probes.h"
+#include "Profile.h"
+#include "Schedule.h"
+#include "Scan.h"
+#include "Cache.h"
 
 #ifdef WIN_AUTO_VERSION
 namespace AGSJoystickMM {
@@ -39,37 +49,28 @@ using namespace AGSJoyAPI;
 #define sprintf_s snprintf
 #endif
 
-#ifndef DEBUG
-#define Dprintf(...) ((void) 0)
-#else
-#include <stdarg.h>
-
-void Dprintf(const char *fmt, ...)
-{
-	char buffer[512];
-	
-	va_list args;
-	va_start(args, fmt);
-	
-	vsprintf(buffer, fmt, args);
-	engine->PrintDebugConsole(buffer);
-	
-	va_end(args);
-}
-#endif
-
 //==============================================================================
 
+#define JOY_RECHECK 64 // Merges between queries of unplugged slots
+
 struct JoyState;
+struct JoyCaps;
+struct JoyScale;
 struct Joystick;
 
 int count = 0;                // Number of joysticks found
 std::vector<int> map;         // Maps joystick ID to device ID
 std::vector<long> hash;       // Maps joystick ID to a unique device hash
+std::vector<JoyCaps> caps;    // Maps joystick ID to its capabilities
+std::vector<bool> unplugged;  // Maps joystick ID to whether its last query found it unplugged
 std::set<Joystick *> joyset;  // Keep opened joysticks
 Joystick dummy;               // Fake joystick for fallback behaviour
+Joystick aggregate;           // All devices merged (JOY_ANY, see Any.h)
+AGSJoyScan::Job scan;         // Enumerates the devices at startup
+AGSJoyCache::Store cache;     // What earlier scans found, by slot (see Cache.h)
+unsigned merges = 0;          // Of the aggregate, see JOY_RECHECK
 
-// Invariant I: map.size() == count == hash.size()
+// Invariant I: map.size() == count == hash.size() == caps.size()
 // Invariant II: joy.id != INVALID_JOY <=> joy.state != NULL
 // Invariant III: joy.id != INVALID_JOY => map[joy.id] exists
 
@@ -78,22 +79,40 @@ inline Joystick *Joystick_find(long index); // Find an open joystick instance (o
 Joystick *Joystick_create(long index); // Create a new joystick instance
 long Joystick_status(Joystick *);      // Device status: is it plugged in? etc.
 void Joystick_update(Joystick *);      // Update axes, button and pov state
+MMRESULT Joystick_query(int id, JOYINFOEX &); // Reads the state of a device
+int32_t Joystick_pov(DWORD pov);       // Pov bits of a pov angle
+void Joystick_guid(const JOYCAPS &, uint8_t *guid); // Key of its mapping
 void Joystick_process(Joystick *);     // Process events (when enabled)
-const char *Joystick_getname(long index);
-long Joystick_hash(int id);
+bool Joystick_caps(int id, JoyCaps &); // Queries the device capabilities
+long Joystick_hash(const JoyCaps &);
+std::string Joystick_slot(int id);     // Cheap status of a device slot
+std::string Joystick_key(int id);      // Cache key of a device slot
+void Joystick_probeall(const std::vector<int> &ids, std::vector<int> &found,
+	std::vector<JoyCaps> &caps);
+void Joystick_enumerate();             // Runs the startup scan
+inline void Joystick_ready() { scan.wait(); } // Waits for the startup scan
 
 //------------------------------------------------------------------------------
 
-struct JoyState
+/// Device capabilities; queried once when the device is found, so opening a
+/// joystick or asking its name does not go back to the driver.
+struct JoyCaps
+{
+	JOYCAPS info;                 // Axis ranges, button and axis count, pov
+	std::string name;             // OEM name from the registry
+	std::string oem;              // Its registry key, what the hash is made of
+};
+
+//------------------------------------------------------------------------------
+
+/// Axis calibration, from the ranges the driver reports
+struct JoyScale
 {
-	long  x,  y,  z,  u,  v,  w;  // Used to store the last axis states
-	long  pov;                    // Used to store the last pov state
-	unsigned long  buttons;       // Used to store the last button states
 	float fx, fy, fz, fu, fv, fw; // Used for callibration
 	int   ox, oy, oz, ou, ov, ow; // idem
 	
-	JoyState (JOYCAPS &caps) : buttons(0)
-	{		
+	JoyScale (const JOYCAPS &caps)
+	{
 		const long scale = 65535;
 		const long min = -32768;
 		
@@ -105,6 +124,44 @@ struct JoyState
 		fw = (float) scale / (caps.wVmax - caps.wVmin); ow = min - caps.wVmin;
 	}
 	
+	/// Calibrates the axes of a reading into x-w
+	void apply(const JOYINFOEX &info, int32_t *axis) const
+	{
+		axis[0] = (int32_t) ((ox + ((float) info.dwXpos)) * fx);
+		axis[1] = (int32_t) ((oy + ((float) info.dwYpos)) * fy);
+		axis[2] = (int32_t) ((oz + ((float) info.dwZpos)) * fz);
+		axis[3] = (int32_t) ((ou + ((float) info.dwRpos)) * fu);
+		axis[4] = (int32_t) ((ov + ((float) info.dwUpos)) * fv);
+		axis[5] = (int32_t) ((ow + ((float) info.dwVpos)) * fw);
+	}
+};
+
+//------------------------------------------------------------------------------
+
+struct JoyState
+{
+	int32_t x, y, z, u, v, w;     // Used to store the last axis states
+	int32_t pov;                  // Used to store the last pov state
+	uint32_t buttons;             // Used to store the last button states
+	int32_t axis[6];              // Calibrated axes before the deadzone (for the aggregate)
+	JoyScale scale;
+	uint64_t latched;             // Time the joystick state was last read
+	uint64_t stamp;               // Time of the last change in that state
+	AGSJoySchedule::Poll schedule; // Backs off polling while idle
+	
+	JoyState (const JOYCAPS &caps) : buttons(0), scale(caps), latched(0), stamp(0)
+	{
+		memset(axis, 0, sizeof (axis));
+		AGSJoyStats::open.add();
+		JoystickActive(true);
+	}
+	
+	~JoyState()
+	{
+		AGSJoyStats::open.sub();
+		JoystickActive(false);
+	}
+	
 	void update(Joystick *joy)
 	{
 		x = joy->x; y = joy->y; z = joy->z;
@@ -118,18 +175,14 @@ struct JoyState
 
 void Initialize()
 {
-	JOYCAPS joy;
-	
-	// Detect devices
-	for (int i = 0, num = joyGetNumDevs(); i < num; ++i)
-	{
-		if (!joyGetDevCaps(i, &joy, sizeof (joy)))
-		{
-			hash.push_back(Joystick_hash(i));
-			++count;
-			map.push_back(i);
-		}
-	}
+	// Querying every slot can take a while, so this does not hold up the
+	// engine; the first call that needs the device list waits for it instead.
+	// Lazy builds only scan then, games that never use a controller don't.
+	#ifdef JOY_LAZY
+	scan.defer(Joystick_enumerate);
+	#else
+	scan.start(Joystick_enumerate);
+	#endif
 	
 	// Set up fake joystick instance
 	memset(&dummy, 0, sizeof (Joystick));
@@ -140,6 +193,10 @@ void Initialize()
 
 void Update()
 {
+	// Nothing can be open before the scan is done
+	if (!scan.done())
+		return;
+	
 	std::set<Joystick *>::iterator it;
 	for (it = joyset.begin(); it != joyset.end(); ++it)
 	{
@@ -147,20 +204,49 @@ void Update()
 		if (joy->id == INVALID_JOY)
 			continue;
 		
+		// Idle devices are polled less often, see Schedule.h
+		JoyState &s = *joy->state;
+		if (!s.schedule.due())
+		{
+			AGSJoyStats::skipped.add();
+			continue;
+		}
+		
+		uint64_t stamp = s.stamp;
 		Joystick_update(joy);
+		s.schedule.polled(s.stamp != stamp);
 		Joystick_process(joy);
 	}
+	
+	// Skipped devices still hold their last state
+	Joystick_any(aggregate);
+	Joystick_actions(joyset);
 }
 
 //------------------------------------------------------------------------------
 
 void Terminate()
 {
+	scan.finish(); // A deferred scan is dropped
+	AGSJoyScan::Join();
+	Joystick_anydispose(aggregate);
 	joyset.clear();
 	map.clear();
+	hash.clear();
+	caps.clear();
+	unplugged.clear();
+	cache.clear();
 	count = 0;
 }
 
+//------------------------------------------------------------------------------
+
+bool Background(bool enable)
+{
+	// joyGetPosEx can only be polled
+	return false;
+}
+
 //==============================================================================
 
 int AGSJoystick::Dispose(const char *address, bool force)
@@ -170,10 +256,17 @@ int AGSJoystick::Dispose(const char *address, bool force)
 	// Never delete the fake joystick instance
 	if (joy == &dummy)
 		return 1;
-
+	
+	// Nor the aggregate, it is only closed
+	if (joy == &aggregate)
+	{
+		Joystick_anydispose(aggregate);
+		return 1;
+	}
+	
 	joyset.erase(joy);
 	
-	Dprintf("[Joystick] Deleted: #%d %p\n", joy->id, joy);
+	TRACE(TRACE_DELETED, joy->id, (intptr_t) joy);
 	if (joy->state)
 			delete joy->state;
 	delete joy;
@@ -183,53 +276,58 @@ int AGSJoystick::Dispose(const char *address, bool force)
 
 //------------------------------------------------------------------------------
 
-#pragma pack(push, 1)
-struct AGSJoystickSerial
-{
-	long hash;
-	long events;
-};
-#pragma pack(pop)
-
-//------------------------------------------------------------------------------
-
 int AGSJoystick::Serialize(const char *address, char *buffer, int bufsize)
 {
 	Joystick *joy = (Joystick *)address;
 	
-	if (joy->id == INVALID_JOY || sizeof (AGSJoystickSerial) > bufsize)
+	if (joy->id == INVALID_JOY)
 		return 0;
 	
-	AGSJoystickSerial serial = { hash[joy->id], joy->events };
-	memcpy(buffer, &serial, sizeof (AGSJoystickSerial));
+	AGSJoySerial::Record serial;
+	serial.hash = (joy->id == JOY_ANY) ? RECORD_ANY : (uint32_t) hash[joy->id];
+	serial.events = joy->events;
+	serial.deadzone = joy->deadzone;
+	serial.threshold = joy->threshold;
+	serial.mask = joy->mask;
 	
-	return sizeof (AGSJoystickSerial);
+	PROBE2(save, joy->id, serial.hash);
+	return AGSJoySerial::Write(serial, buffer, bufsize);
 }
 
 //------------------------------------------------------------------------------
 
 void AGSJoystick::Unserialize(int key, const char *serializedData, int dataSize)
 {
-	if (dataSize != sizeof (AGSJoystickSerial))
+	AGSJoySerial::Record serial = { 0, 0, 0, JOY_THRESHOLD, JOY_EVENT_ALL };
+	Joystick_ready();
+	if (!AGSJoySerial::Read(serial, serializedData, dataSize))
 	{
 		// Savefile incompatible, damaged or a fake joy
 		AGS_RESTORE(Joystick, &dummy, key);
 		return;
 	}
-
-	AGSJoystickSerial serial;
-	memcpy(&serial, serializedData, sizeof (AGSJoystickSerial));
+	
+	if (serial.hash == RECORD_ANY)
+	{
+		Joystick_anyrestore(aggregate, serial, key);
+		return;
+	}
 	
 	// Find previous used device
 	for (int i = 0; i < count; ++i)
 	{
-		if (serial.hash == hash[i]) // Found
+		if (serial.hash == (uint32_t) hash[i]) // Found
 		{
 			// We do not return already open instances since this would probably
 			// cause problems with AGS' garbage collector.
 			// Simply create a new instance always
 			Joystick *joy = Joystick_create(i);
-			Dprintf("[Joystick] Created from savefile: #%d %p\n", joy->id, joy);
+			TRACE(TRACE_RESTORED, joy->id, (intptr_t) joy);
+			PROBE2(restore, joy->id, serial.hash);
+			joy->events = serial.events;
+			joy->deadzone = serial.deadzone;
+			joy->threshold = serial.threshold;
+			joy->mask = serial.mask;
 			joyset.insert(joy);
 			
 			AGS_RESTORE(Joystick, joy, key);
@@ -238,6 +336,7 @@ void AGSJoystick::Unserialize(int key, const char *serializedData, int dataSize)
 	}
 	
 	// Device no longer present, invalidate joystick
+	PROBE2(restore, INVALID_JOY, serial.hash);
 	AGS_RESTORE(Joystick, &dummy, key);
 }
 
@@ -245,6 +344,7 @@ void AGSJoystick::Unserialize(int key, const char *serializedData, int dataSize)
 
 long JoystickCount()
 {
+	Joystick_ready();
 	return count;
 }
 
@@ -252,29 +352,38 @@ long JoystickCount()
 
 long JoystickRescan()
 {
-	JOYCAPS joy;
-	long found = false;
+	Joystick_ready();
+	PROFILE(STAGE_ENUMERATE);
 	
 	// Construct a set with already found devices (by device id)
 	std::set<int> list;
 	for (int i = 0; i < (int) map.size(); ++i)
 		list.insert(map[i]);
-
+	
+	std::vector<int> ids, found;
 	for (int i = 0, num = joyGetNumDevs(); i < num; ++i)
+		if (list.count(i) < 1)
+			ids.push_back(i);
+	
+	std::vector<JoyCaps> joy;
+	Joystick_probeall(ids, found, joy);
+	cache.save();
+	
+	// Unplugged devices are queried again as well
+	unplugged.assign(unplugged.size(), false);
+	
+	for (size_t i = 0; i < found.size(); ++i) // New (working) device found
 	{
-		if (!joyGetDevCaps(i, &joy, sizeof (joy)))
-		{
-			if (list.count(i) < 1) // New (working) device found
-			{
-				hash.push_back(Joystick_hash(i));
-				count++;
-				map.push_back(i);
-				found = true;
-			}
-		}
+		hash.push_back(Joystick_hash(joy[i]));
+		caps.push_back(joy[i]);
+		unplugged.push_back(false);
+		count++;
+		map.push_back(found[i]);
+		AGSJoyStats::hotplug.add();
+		PROBE1(hotplug__add, count - 1);
 	}
-
-	return found ? 1 : 0;
+	
+	return found.empty() ? 0 : 1;
 }
 
 //------------------------------------------------------------------------------
@@ -282,7 +391,7 @@ long JoystickRescan()
 const char *JoystickName(long index)
 {
 	// Debug information (undocumented)
-	if (index == -2)
+	if (index == JOY_DEBUG_VERSION)
 	{
 		#ifdef WINMM_VERSION
 		#	define VER_AUTO ""
@@ -291,11 +400,19 @@ const char *JoystickName(long index)
 		#endif
 		return AGS_STRING(PRODUCT_NAME " v" FILE_VERSION " " VER_AUTO "winmm");
 	}
+	if (index == JOY_DEBUG_TRACE)
+	{
+		AGSJoyTrace::Dump();
+		return AGS_STRING("");
+	}
+	if (index <= JOY_DEBUG_LATENCY)
+		return AGS_STRING(AGSJoyStats::Report(index));
 	
+	Joystick_ready();
 	if ((index < 0) || (index >= count))
 		return AGS_STRING("");
 	
-	return AGS_STRING(Joystick_getname(index));
+	return AGS_STRING(caps[index].name.c_str());
 }
 
 //==============================================================================
@@ -307,7 +424,12 @@ Joystick *Joystick_Open(long index)
 		AGS_OBJECT(Joystick, &dummy);
 		return &dummy;
 	}
-
+	
+	// The aggregate walks the devices too, so it waits for the scan as well
+	Joystick_ready();
+	if (index == JOY_ANY) // One instance for all devices (see Any.h)
+		return Joystick_anyobject(aggregate);
+	
 	if ((index < 0) || (index >= count))
 		engine->AbortGame("!JoystickOpen: No device exists for specified index.");
 	
@@ -321,7 +443,7 @@ Joystick *Joystick_Open(long index)
 	
 	// Create a new joystick instance
 	joy = Joystick_create(index);
-	Dprintf("[Joystick] Created from scratch: #%d %p\n", joy->id, joy);
+	TRACE(TRACE_CREATED, joy->id, (intptr_t) joy);
 	
 	AGS_OBJECT(Joystick, joy);
 	joyset.insert(joy);
@@ -332,11 +454,14 @@ Joystick *Joystick_Open(long index)
 
 long Joystick_IsOpen(long index)
 {
+	if (index == JOY_ANY)
+		return AGSJoyAny::Opened() ? 1 : 0;
+	
 	std::set<Joystick *>::iterator it;
 	for (it = joyset.begin(); it != joyset.end(); ++it)
 		if ((*it)->id == index)
 			return 1;
-
+	
 	return 0;
 }
 
@@ -352,12 +477,18 @@ void Joystick_Click(long button)
 void Joystick_Close(Joystick *joy)
 {
 	joyset.erase(joy);
+	if (joy == &aggregate)
+	{
+		Joystick_anyclose(aggregate);
+		return;
+	}
+	
 	if (!joy || joy->id == INVALID_JOY)
 		return;
 	
 	if (joy->state)
 		delete joy->state;
-
+	
 	memset(joy, 0, sizeof (Joystick));
 	joy->id = INVALID_JOY;
 }
@@ -369,6 +500,9 @@ long Joystick_Valid(Joystick *joy)
 	if (!joy || joy->id == INVALID_JOY)
 		return 0;
 	
+	if (joy->id == JOY_ANY)
+		return 1;
+	
 	if (Joystick_status(joy) == MMSYSERR_NODRIVER)
 		return 0;
 	
@@ -382,6 +516,9 @@ long Joystick_Unplugged(Joystick *joy)
 	if (!joy || joy->id == INVALID_JOY)
 		return 0;
 	
+	if (joy->id == JOY_ANY)
+		return AGSJoyAny::Unplugged() ? 1 : 0;
+	
 	return (Joystick_status(joy) == JOYERR_UNPLUGGED) ? 1 : 0;
 }
 
@@ -389,10 +526,10 @@ long Joystick_Unplugged(Joystick *joy)
 
 const char *Joystick_GetName(Joystick *joy)
 {
-	if (joy->id == INVALID_JOY)
+	if (joy->id == INVALID_JOY || joy->id == JOY_ANY)
 		return AGS_STRING("");
 	
-	return AGS_STRING(Joystick_getname(joy->id));
+	return AGS_STRING(caps[joy->id].name.c_str());
 }
 
 //------------------------------------------------------------------------------
@@ -424,7 +561,9 @@ long Joystick_IsButtonDown(Joystick *joy, long button)
 
 void Joystick_Update(Joystick *joy)
 {
-	if (Joystick_Valid(joy))
+	if (joy && joy->id == JOY_ANY)
+		Joystick_any(*joy);
+	else if (Joystick_Valid(joy))
 		Joystick_update(joy);
 }
 
@@ -432,7 +571,8 @@ void Joystick_Update(Joystick *joy)
 
 void Joystick_EnableEvents(Joystick *joy, long scope)
 {
-	if (!joy || joy->id == INVALID_JOY)
+	// The aggregate has none, the devices' own instances raise them
+	if (!joy || joy->id == INVALID_JOY || joy->id == JOY_ANY)
 		return;
 	
 	joy->state->update(joy);
@@ -449,6 +589,64 @@ void Joystick_DisableEvents(Joystick *joy)
 	joy->events = 0;
 }
 
+//------------------------------------------------------------------------------
+
+void Joystick_SetDeadzone(Joystick *joy, long deadzone)
+{
+	if (!joy || joy->id == INVALID_JOY)
+		return;
+	
+	joy->deadzone = (deadzone < 0) ? 0 : deadzone;
+}
+
+//------------------------------------------------------------------------------
+
+void Joystick_SetThreshold(Joystick *joy, long threshold)
+{
+	if (!joy || joy->id == INVALID_JOY)
+		return;
+	
+	joy->threshold = (threshold < 0) ? 0 : threshold;
+}
+
+//------------------------------------------------------------------------------
+
+void Joystick_SetEventMask(Joystick *joy, long mask)
+{
+	if (!joy || joy->id == INVALID_JOY)
+		return;
+	
+	joy->mask = mask & JOY_EVENT_ALL;
+}
+
+//------------------------------------------------------------------------------
+
+long Joystick_GetInputAge(Joystick *joy)
+{
+	if (!joy || joy->id == INVALID_JOY)
+		return 0;
+	
+	if (joy->id == JOY_ANY)
+		return AGSJoyAny::InputAge();
+	
+	uint64_t age = AGSJoyClock::Now() - joy->state->latched;
+	return (age > 0x7FFFFFFF) ? 0x7FFFFFFF : (long) age;
+}
+
+//------------------------------------------------------------------------------
+
+long Joystick_GetEventAge(Joystick *joy)
+{
+	if (!joy || joy->id == INVALID_JOY)
+		return 0;
+	
+	if (joy->id == JOY_ANY)
+		return AGSJoyAny::EventAge();
+	
+	uint64_t age = AGSJoyClock::Now() - joy->state->stamp;
+	return (age > 0x7FFFFFFF) ? 0x7FFFFFFF : (long) age;
+}
+
 //==============================================================================
 
 inline Joystick *Joystick_find(long index)
@@ -465,20 +663,25 @@ inline Joystick *Joystick_find(long index)
 
 Joystick *Joystick_create(long index) // Pre: map[index] exists
 {
-	JOYCAPS caps;
-	joyGetDevCaps(map[index], &caps, sizeof (caps));
+	const JOYCAPS &info = caps[index].info;
 	
 	Joystick *joy = new Joystick;
 	memset(joy, 0, sizeof (Joystick));
 	
 	joy->id = index; // joystick id, not device id
-	joy->button_count = caps.wNumButtons;
-	joy->axis_count = caps.wNumAxes;
+	joy->button_count = info.wNumButtons;
+	joy->axis_count = info.wNumAxes;
+	joy->threshold = JOY_THRESHOLD;
+	joy->mask = JOY_EVENT_ALL;
+	
+	joy->state = new JoyState(info);
 	
-	joy->state = new JoyState(caps);
+	uint8_t guid[16];
+	Joystick_guid(info, guid);
+	AGSJoyMap::Attach(joy->pad, guid);
 	Joystick_update(joy);
 	joy->state->update(joy);
-
+	
 	return joy;
 }
 
@@ -490,7 +693,14 @@ long Joystick_status(Joystick *joy) // Pre: joy->id != INVALID_JOY
 	info.dwSize = sizeof (info);
 	info.dwFlags = JOY_RETURNALL;
 	
-	return joyGetPosEx(map[joy->id], &info);
+	MMRESULT result = joyGetPosEx(map[joy->id], &info);
+	unplugged[joy->id] = (result == JOYERR_UNPLUGGED);
+	
+	// Buttons held on an idle device: poll it at full rate again
+	if (!result && info.dwButtons != joy->buttons)
+		joy->state->schedule.wake();
+	
+	return result;
 }
 
 //------------------------------------------------------------------------------
@@ -498,54 +708,170 @@ long Joystick_status(Joystick *joy) // Pre: joy->id != INVALID_JOY
 void Joystick_update(Joystick *joy) // Pre: joy->id != INVALID_JOY
 {
 	JOYINFOEX info;
-	info.dwSize = sizeof (info);
-	info.dwFlags = JOY_RETURNALL & ~JOY_RETURNPOV;
-	//if (Has a POV control) Will it fail otherwise?
-		info.dwFlags |= JOY_RETURNPOVCTS;
-	info.dwPOV = 0;
+	MMRESULT result;
+	{
+		PROFILE(STAGE_READ);
+		result = Joystick_query(map[joy->id], info);
+	}
 	
-	if (joyGetPosEx(map[joy->id], &info))
+	unplugged[joy->id] = (result == JOYERR_UNPLUGGED);
+	if (result)
 	{
 		// Error!
-		Dprintf("[Joystick] Could not update joy: #%d %p\n", joy->id, joy);
+		TRACE(TRACE_READ_FAILED, joy->id, (intptr_t) joy);
 		return;
 	}
 	
 	JoyState &s = *joy->state;
-	joy->x = (long) ((s.ox + ((float) info.dwXpos)) * s.fx);
-	joy->y = (long) ((s.oy + ((float) info.dwYpos)) * s.fy);
-	joy->z = (long) ((s.oz + ((float) info.dwZpos)) * s.fz);
-	joy->u = (long) ((s.ou + ((float) info.dwRpos)) * s.fu);
-	joy->v = (long) ((s.ov + ((float) info.dwUpos)) * s.fv);
-	joy->w = (long) ((s.ow + ((float) info.dwVpos)) * s.fw);
+	s.latched = AGSJoyClock::Now();
+	AGSJoyStats::events.add();
+	PROBE2(read, joy->id, 1);
+	
+	// winmm has no event timestamps: a change is stamped when it is seen
+	char before[JOY_EXPOSED_SIZE];
+	memcpy(before, joy, JOY_EXPOSED_SIZE);
+	
+	{
+	PROFILE(STAGE_CALIBRATE);
+	s.scale.apply(info, &joy->x); // x-w are consecutive
+	memcpy(s.axis, &joy->x, sizeof (s.axis));
+	}
+	
+	if (joy->deadzone)
+	{
+		PROFILE(STAGE_FILTER);
+		int32_t *axis[] = { &joy->x, &joy->y, &joy->z, &joy->u, &joy->v, &joy->w };
+		for (int i = 0; i < 6; ++i)
+			if ((*axis[i] < joy->deadzone) && (*axis[i] > -joy->deadzone))
+				*axis[i] = 0;
+	}
 	
 	joy->buttons = info.dwButtons;
+	joy->pov = Joystick_pov(info.dwPOV);
+	
+	if (memcmp(before, joy, JOY_EXPOSED_SIZE))
+		s.stamp = s.latched;
+	
+	AGSJoyMap::Apply(joy->pad, &joy->x, joy->pov, joy->buttons);
+}
+
+//------------------------------------------------------------------------------
+
+MMRESULT Joystick_query(int id, JOYINFOEX &info)
+{
+	info.dwSize = sizeof (info);
+	info.dwFlags = JOY_RETURNALL & ~JOY_RETURNPOV;
+	//if (Has a POV control) Will it fail otherwise?
+		info.dwFlags |= JOY_RETURNPOVCTS;
+	info.dwPOV = 0;
 	
-	long &pov = joy->pov;
-	pov = 0;
-	if (info.dwPOV == JOY_POVCENTERED)
+	return joyGetPosEx(id, &info);
+}
+
+//------------------------------------------------------------------------------
+
+int32_t Joystick_pov(DWORD angle)
+{
+	int32_t pov = 0;
+	if (angle != JOY_POVCENTERED)
+	{
+		if (angle > JOY_POVBACKWARD)
+			pov |= 8; /* Left */
+		else if ((angle < JOY_POVBACKWARD) && (angle > JOY_POVFORWARD))
+			pov |= 2; /* Right */
+		
+		if ((angle > JOY_POVRIGHT) && (angle < JOY_POVLEFT))
+			pov |= 4; /* Down */
+		else if ((angle < JOY_POVRIGHT) || (angle > JOY_POVLEFT))
+			pov |= 1; /* Up */
+	}
+	return pov;
+}
+
+//------------------------------------------------------------------------------
+
+void Joystick_guid(const JOYCAPS &info, uint8_t *guid)
+{
+	// Built as SDL does for DirectInput devices (winmm has no bus or version)
+	AGSJoyMap::Guid(guid, 0x03, info.wMid, info.wPid, 0, info.szPname);
+}
+
+//------------------------------------------------------------------------------
+
+void Joystick_any(Joystick &joy)
+{
+	if (!AGSJoyAny::Opened())
 		return;
 	
-	if (info.dwPOV > JOY_POVBACKWARD)
-		pov |= 8; /* Left */
-	else if ((info.dwPOV < JOY_POVBACKWARD) && (info.dwPOV > JOY_POVFORWARD))
-		pov |= 2; /* Right */
+	// winmm keeps no state: a device with an open instance merges what
+	// Update just read, the others are queried here (the merge stamps the
+	// changes, as there are no timestamps). Unplugged slots are slow to
+	// query, they are only tried again every JOY_RECHECK merges.
+	bool recheck = !(++merges % JOY_RECHECK);
 	
-	if ((info.dwPOV > JOY_POVRIGHT) && (info.dwPOV < JOY_POVLEFT))
-		pov |= 4; /* Down */
-	else if ((info.dwPOV < JOY_POVRIGHT) || (info.dwPOV > JOY_POVLEFT))
-		pov |= 1; /* Up */
+	AGSJoyAny::Begin(joy.deadzone);
+	for (int i = 0; i < count; ++i)
+	{
+		AGSJoyAny::Device merged;
+		
+		Joystick *inst = Joystick_find(i);
+		if (inst)
+		{
+			if (unplugged[i])
+				continue;
+			
+			memcpy(merged.axis, inst->state->axis, sizeof (merged.axis));
+			merged.pov = inst->pov;
+			merged.buttons = inst->buttons;
+		}
+		else
+		{
+			if (unplugged[i] && !recheck)
+				continue;
+			
+			JOYINFOEX info;
+			MMRESULT result;
+			{
+				PROFILE(STAGE_READ);
+				result = Joystick_query(map[i], info);
+			}
+			
+			unplugged[i] = (result == JOYERR_UNPLUGGED);
+			if (result)
+				continue;
+			
+			JoyScale(caps[i].info).apply(info, merged.axis);
+			merged.pov = Joystick_pov(info.dwPOV);
+			merged.buttons = info.dwButtons;
+		}
+		
+		const JOYCAPS &c = caps[i].info;
+		uint8_t guid[16];
+		Joystick_guid(c, guid);
+		
+		merged.button_count = c.wNumButtons;
+		merged.axis_count = c.wNumAxes;
+		merged.stamp = 0;
+		merged.guid = guid;
+		AGSJoyAny::Add(i, merged);
+	}
+	AGSJoyAny::End();
+	
+	Joystick_anycopy(joy);
 }
 
 //------------------------------------------------------------------------------
 
 #define JOY_START_AXIS_CHECK { int change;
 #define JOY_AXIS_CHECK(a,i) change = joy->a - last->a; \
-	if ((change > JOY_THRESHOLD) || (change < -JOY_THRESHOLD)) axes |= 1 << i;
+	if ((change > joy->threshold) || (change < -joy->threshold)) axes |= 1 << i;
 #define JOY_END_AXIS_CHECK }
 
-#define JOY_EVENT(e,v) \
-	engine->QueueGameScriptFunction(e, joy->events - 1, 2, (long) joy, v);
+#define JOY_EVENT(e,v) { \
+	engine->QueueGameScriptFunction(e, joy->events - 1, 2, (long) joy, v); \
+	AGSJoyStats::latency.add(AGSJoyClock::Now() - last->stamp); \
+	AGSJoyStats::queued.add(); \
+	PROBE3(queue, joy->id, e, v); }
 
 void Joystick_process(Joystick *joy) // Pre: joy->id != INVALID_JOY
 {
@@ -556,41 +882,55 @@ void Joystick_process(Joystick *joy) // Pre: joy->id != INVALID_JOY
 	int axes = 0;
 	long pressed;
 	bool hat;
-
-	JOY_START_AXIS_CHECK
-		JOY_AXIS_CHECK(x, 0)
-		JOY_AXIS_CHECK(y, 1)
-		JOY_AXIS_CHECK(z, 2)
-		JOY_AXIS_CHECK(u, 3)
-		JOY_AXIS_CHECK(v, 4)
-		JOY_AXIS_CHECK(w, 5)
-	JOY_END_AXIS_CHECK
-
-	pressed = joy->buttons ^ last->buttons;
-	hat = joy->pov != last->pov;
-
+	
+	{
+		PROFILE(STAGE_DETECT);
+		
+		JOY_START_AXIS_CHECK
+			JOY_AXIS_CHECK(x, 0)
+			JOY_AXIS_CHECK(y, 1)
+			JOY_AXIS_CHECK(z, 2)
+			JOY_AXIS_CHECK(u, 3)
+			JOY_AXIS_CHECK(v, 4)
+			JOY_AXIS_CHECK(w, 5)
+		JOY_END_AXIS_CHECK
+		
+		pressed = joy->buttons ^ last->buttons;
+		hat = joy->pov != last->pov;
+		
+		if (!(joy->mask & JOY_EVENT_MOVE))
+			axes = 0;
+		if (!(joy->mask & JOY_EVENT_PRESS))
+			pressed = 0;
+		if (!(joy->mask & JOY_EVENT_POV))
+			hat = false;
+	}
+	
 	if (!(axes || pressed || hat))
 		return;
-
+	
+	PROBE4(process, joy->id, axes, pressed, hat);
+	PROFILE(STAGE_DISPATCH);
+	
 	last->update(joy);
-
+	
 	{
 		int axis = 0;
-
+		
 		while (axes)
 		{
 			if (axes & 1)
 				JOY_EVENT("on_joy_move", axis);
-
+			
 			axes >>= 1;
 			axis++;
 		}
 	}
-
+	
 	{	
 		int button = 0;
 		pressed &= joy->buttons; // ignore button releases
-
+		
 		while (pressed)
 		{
 			if (pressed & 1)
@@ -608,14 +948,14 @@ void Joystick_process(Joystick *joy) // Pre: joy->id != INVALID_JOY
 //------------------------------------------------------------------------------
 // This code have been borrowed from SDL2; original by Eckhard Stolberg.
 
-const char *Joystick_getname(long index) // Pre: map[index] exists
+bool Joystick_caps(int id, JoyCaps &joy)
 {
-	const long id = map[index];
 	static const char *unknown = "Unknown joystick";
-	JOYCAPS caps;
+	JOYCAPS &caps = joy.info;
 	
+	memset(&caps, 0, sizeof (caps)); // Padding too, it is compared as a whole
 	if (joyGetDevCaps(id, &caps, sizeof (caps)))
-		return AGS_STRING("");
+		return false;
 	
 	char path[512];
 	char value[512];
@@ -623,11 +963,14 @@ const char *Joystick_getname(long index) // Pre: map[index] exists
 	HKEY root;
 	HKEY key;
 	
+	joy.name = unknown;
+	joy.oem.clear();
+	
 	// Open joystick device registery
 	if (sprintf_s(path, sizeof (path), "%s\\%s\\%s", REGSTR_PATH_JOYCONFIG, caps.szRegKey, REGSTR_KEY_JOYCURR) < 0
 	|| (RegOpenKeyExA(root = HKEY_LOCAL_MACHINE, path, 0, KEY_READ, &key)
 	&& RegOpenKeyExA(root = HKEY_CURRENT_USER, path, 0, KEY_READ, &key)))
-		return AGS_STRING(unknown);
+		return true;
 	
 	// Get Joystick keyname in registery
 	size = sizeof (value);
@@ -635,71 +978,171 @@ const char *Joystick_getname(long index) // Pre: map[index] exists
 	|| RegQueryValueExA(key, path, 0, 0, (BYTE *) value, (DWORD *) &size))
 	{
 		RegCloseKey(key);
-		return AGS_STRING(unknown);
+		return true;
 	}
 	RegCloseKey(key);
-
+	joy.oem = value;
+	
 	// Get the value of the key
 	if (sprintf_s(path, sizeof (path), "%s\\%s", REGSTR_PATH_JOYOEM, value) < 0
 	|| RegOpenKeyExA(root, path, 0, KEY_READ, &key))
-		return AGS_STRING(unknown);
-
+		return true;
+	
 	// Get the name
 	size = sizeof (value);
 	if (RegQueryValueExA(key, REGSTR_VAL_JOYOEMNAME, 0, 0, (BYTE *) value, (DWORD *) &size))
 	{
 		RegCloseKey(key);
-		return AGS_STRING(unknown);
+		return true;
 	}
 	RegCloseKey(key);
 	
-	return AGS_STRING(value);
+	joy.name = value;
+	return true;
 }
 
 //------------------------------------------------------------------------------
 
-inline void getoemname(int id, char *value, size_t size)
+std::string Joystick_slot(int id)
 {
-	*value = 0;
+	JOYINFOEX info;
+	info.dwSize = sizeof (info);
+	info.dwFlags = JOY_RETURNBUTTONS;
 	
-	JOYCAPS caps;
-	if (joyGetDevCaps(id, &caps, sizeof (caps)))
-		return;
+	AGSJoyCache::Writer out;
+	out.u32(joyGetPosEx(id, &info));
+	return out.out;
+}
+
+std::string Joystick_key(int id)
+{
+	char key[16];
+	sprintf_s(key, sizeof (key), "%d", id);
+	return key;
+}
+
+//------------------------------------------------------------------------------
+
+/// Queries one device slot on a worker thread
+struct JoyProbe : AGSJoyScan::Task
+{
+	int id;
+	bool found;
+	std::string status;           // Of the slot when no device was found
+	std::string ident, data;      // Capabilities, name and OEM key found before
+	JoyCaps joy;
 	
-	char path[512];
-	HKEY root;
-	HKEY key;
+	JoyProbe(int slot, const AGSJoyCache::Entry *entry) : id(slot), found(false)
+	{
+		if (entry && !entry->data.empty())
+			ident = entry->ident, data = entry->data;
+	}
 	
-	// Open joystick device registery
-	if (sprintf_s(path, sizeof (path), "%s\\%s\\%s", REGSTR_PATH_JOYCONFIG, caps.szRegKey, REGSTR_KEY_JOYCURR) < 0
-	|| (RegOpenKeyExA(root = HKEY_LOCAL_MACHINE, path, 0, KEY_READ, &key)
-	&& RegOpenKeyExA(root = HKEY_CURRENT_USER, path, 0, KEY_READ, &key)))
-		return;
+	void run()
+	{
+		// A device with the same capabilities as before keeps its name and
+		// OEM key; the registry lookups are what makes a probe slow.
+		if (ident.size() == sizeof (JOYCAPS))
+		{
+			AGSJoyCache::Reader in(data);
+			joy.name = in.str();
+			joy.oem = in.str();
+			
+			memset(&joy.info, 0, sizeof (joy.info));
+			if (in.ok && in.pos == data.size()
+			&& !joyGetDevCaps(id, &joy.info, sizeof (joy.info))
+			&& !memcmp(&joy.info, ident.data(), sizeof (JOYCAPS)))
+			{
+				found = true;
+				return;
+			}
+		}
+		
+		found = Joystick_caps(id, joy);
+		if (!found)
+			status = Joystick_slot(id);
+	}
+};
+
+void Joystick_probeall(const std::vector<int> &ids, std::vector<int> &found,
+	std::vector<JoyCaps> &caps)
+{
+	std::vector<AGSJoyScan::Task *> tasks;
+	for (size_t i = 0; i < ids.size(); ++i)
+	{
+		// Skip slots that were rejected before and still report the same;
+		// a device plugged into the slot changes its status
+		const AGSJoyCache::Entry *entry = cache.find(Joystick_key(ids[i]));
+		if (entry && entry->data.empty() && entry->ident == Joystick_slot(ids[i]))
+			continue;
+		
+		tasks.push_back(new JoyProbe(ids[i], entry));
+	}
 	
-	// Get Joystick keyname in registery
-	if (sprintf_s(path, sizeof (path), "Joystick%d%s", id + 1, REGSTR_VAL_JOYOEMNAME) < 0
-	|| RegQueryValueExA(key, path, 0, 0, (BYTE *) value, (DWORD *) &size))
+	// A device that does not answer in time is skipped (until a rescan)
+	AGSJoyScan::Parallel(tasks);
+	
+	for (size_t i = 0; i < tasks.size(); ++i)
 	{
-		RegCloseKey(key);
-		*value = 0;
-		return;
+		JoyProbe *probe = (JoyProbe *) tasks[i];
+		if (!probe)
+			continue;
+		
+		// Replaces the entry of a slot that changed
+		if (probe->found)
+		{
+			AGSJoyCache::Writer out;
+			out.str(probe->joy.name);
+			out.str(probe->joy.oem);
+			
+			found.push_back(probe->id);
+			caps.push_back(probe->joy);
+			cache.put(Joystick_key(probe->id),
+				std::string((const char *) &probe->joy.info, sizeof (JOYCAPS)), out.out);
+		}
+		else
+			cache.put(Joystick_key(probe->id), probe->status, std::string());
+		
+		delete probe;
 	}
-	RegCloseKey(key);
 }
 
-//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - 
+//------------------------------------------------------------------------------
 
-long Joystick_hash(int id)
+void Joystick_enumerate()
 {
-	char value[512];	
-	getoemname(id, value, sizeof (value));
+	PROFILE(STAGE_ENUMERATE);
+	
+	std::vector<int> ids, found;
+	for (int i = 0, num = joyGetNumDevs(); i < num; ++i)
+		ids.push_back(i);
 	
-	// FNV-1a hash algorithm
+	std::vector<JoyCaps> joy;
+	cache.load(AGSJoyCache::Path());
+	Joystick_probeall(ids, found, joy);
+	cache.save();
+	
+	// Detect devices
+	for (size_t i = 0; i < found.size(); ++i)
+	{
+		hash.push_back(Joystick_hash(joy[i]));
+		caps.push_back(joy[i]);
+		unplugged.push_back(false);
+		++count;
+		map.push_back(found[i]);
+	}
+}
+
+//------------------------------------------------------------------------------
+
+long Joystick_hash(const JoyCaps &joy)
+{
+	// FNV-1a hash algorithm over the OEM key (found by Joystick_caps)
 	static const unsigned long basis = 2166136261UL;
 	static const unsigned long prime = 16777619UL;
 	
 	unsigned long h = basis;
-	const unsigned char *ptr = (const unsigned char *)value;
+	const unsigned char *ptr = (const unsigned char *) joy.oem.c_str();
 	
 	while (*ptr)
 		h = (*ptr++ ^ h) * prime;
@@ -1,43 +1,255 @@
 /***********************************************************
  * Joystick interface -- platform specific implementation  *
  *                                                         *
- * Author:                                                 *
+ * Author: Ferry "Wyz" Timmers                             *
  *                                                         *
- * Date:                                                   *
+ * Date: 19:05 19-10-2026                                  *
  *                                                         *
- * Description: Joystick interface SDL version.            *
+ * Description: Joystick interface SDL version, reads      *
+ *              the joystick state SDL keeps.              *
  ***********************************************************/
 
 #include "Joystick.h"
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+#include <set>
+#include <string>
+
+// The backend is selected with SDL_VERSION, which SDL defines itself
+#undef SDL_VERSION
+#include <SDL.h>
+
+#include "version.h"
+#include "Serial.h"
+#include "Clock.h"
+#include "Stats.h"
+#include "Trace.h"
+#include "Probes.h"
+#include "Profile.h"
+#include "Schedule.h"
+#include "Scan.h"
+
 namespace AGSJoystick {
 
 using namespace AGSJoyAPI;
 
+//==============================================================================
+
+#define JOY_AXES    6
+#define JOY_BUTTONS 32
+
+struct JoyState;
+struct JoyDevice;
+struct Joystick;
+
+int count = 0;                  // Number of joysticks found
+std::vector<JoyDevice *> map;   // Maps joystick ID to device
+std::set<Joystick *> joyset;    // Keep opened joysticks
+Joystick dummy;                 // Fake joystick for fallback behaviour
+Joystick aggregate;             // All devices merged (JOY_ANY, see Any.h)
+bool initialized = false;       // We hold a reference to SDL's joystick subsystem
+bool plugged = false;           // SDL reported devices since the last scan
+int devices = 0;                // SDL_NumJoysticks() at the last pump
+SDL_JoystickID newest = -1;     // Instance of the last device SDL listed then
+bool merging = false;           // The aggregate is open, all devices are attached
+AGSJoyScan::Job scan;           // Lazy builds defer the scan to first use
+
+// Invariant I: map.size() == count
+// Invariant II: joy.id != INVALID_JOY <=> joy.state != NULL
+// Invariant III: joy.id != INVALID_JOY => map[joy.id] exists
+// Invariant IV: JoyDevice::refs == number of states referring to the device
+
+// Private methods
+inline Joystick *Joystick_find(long index); // Find an open joystick instance (or NULL)
+Joystick *Joystick_create(long index); // Create a new joystick instance
+void Joystick_release(Joystick *);     // Releases the device of an instance
+void Joystick_update(Joystick *);      // Update axes, button and pov state
+void Joystick_process(Joystick *);     // Process events (when enabled)
+JoyDevice *Joystick_probe(int index);  // Queries a device by SDL device index
+JoyDevice *Joystick_device(SDL_JoystickID); // Device of an SDL instance (or NULL)
+void Joystick_attach(JoyDevice *);     // Opens the SDL joystick of a device
+void Joystick_detach(JoyDevice *);     // Closes it again
+void Joystick_pump();                  // Has SDL update its joystick state
+bool Joystick_poll(JoyDevice *);       // Reads the state SDL keeps, true if it changed
+void Joystick_unplug(JoyDevice *);     // Marks a device as gone
+void Joystick_enumerate();             // Runs the startup scan
+inline void Joystick_ready() { scan.wait(); } // Waits for the startup scan
+
+//------------------------------------------------------------------------------
+
+/// Physical device, shared by all instances that opened it
+struct JoyDevice
+{
+	std::string name;             // Device name
+	int index;                    // Joystick ID
+	uint32_t ident;               // Device hash before collision handling
+	uint32_t hash;                // Unique device hash
+	uint8_t guid[16];             // SDL's GUID, the key of its mapping
+	SDL_JoystickID instance;      // SDL's id for the device while plugged in
+	SDL_Joystick *handle;         // Open while instances or the aggregate use it
+	int refs;                     // Number of open instances
+	bool unplugged;
+	
+	int axis_count;
+	int button_count;
+	int hat_count;
+	
+	// Live state, read back from SDL every update
+	int32_t value[JOY_AXES];      // Axis values (SDL's range is ours)
+	int32_t hat;                  // SDL_HAT_* bits, the same as the pov values
+	uint32_t buttons;
+	uint64_t stamp;               // Time of the newest event
+	AGSJoySchedule::Poll schedule; // Backs off polling while idle
+	
+	JoyDevice() : index(INVALID_JOY), ident(0), hash(0), instance(-1), handle(NULL),
+		refs(0), unplugged(false), axis_count(0), button_count(0), hat_count(0), hat(0),
+		buttons(0), stamp(0)
+	{
+		memset(value, 0, sizeof (value));
+	}
+	
+	~JoyDevice()
+	{
+		if (handle)
+			SDL_JoystickClose(handle);
+	}
+};
+
 //------------------------------------------------------------------------------
 
+struct JoyState
+{
+	JoyDevice *dev;
+	int32_t x, y, z, u, v, w;     // Used to store the last axis states
+	int32_t pov;                  // Used to store the last pov state
+	uint32_t buttons;             // Used to store the last button states
+	uint64_t latched;             // Time the joystick state was last read
+	uint64_t stamp;               // Time of the newest event in that state
+	
+	JoyState (JoyDevice *device) : dev(device), buttons(0), latched(0), stamp(0)
+	{
+		// SDL only keeps the state of opened joysticks
+		if (!dev->refs++)
+			Joystick_attach(dev);
+		AGSJoyStats::open.add();
+		JoystickActive(true);
+	}
+	
+	~JoyState()
+	{
+		if (!--dev->refs && !merging)
+			Joystick_detach(dev);
+		AGSJoyStats::open.sub();
+		JoystickActive(false);
+	}
+	
+	void update(Joystick *joy)
+	{
+		x = joy->x; y = joy->y; z = joy->z;
+		u = joy->u; v = joy->v; w = joy->w;
+		pov = joy->pov;
+		buttons = joy->buttons;
+	}
+};
+
 //==============================================================================
 
 void Initialize()
 {
+	// Starting SDL's joystick subsystem has it look for devices, lazy builds
+	// only do that on first use.
+	#ifdef JOY_LAZY
+	scan.defer(Joystick_enumerate);
+	#else
+	Joystick_enumerate();
+	#endif
+	
+	// Set up fake joystick instance
+	memset(&dummy, 0, sizeof (Joystick));
+	dummy.id = INVALID_JOY;
 }
 
 //------------------------------------------------------------------------------
 
 void Update()
 {
+	// One pump for all devices, SDL keeps their state
+	Joystick_pump();
+	
+	std::set<Joystick *>::iterator it;
+	for (it = joyset.begin(); it != joyset.end(); ++it)
+	{
+		Joystick *joy = *it;
+		if (joy->id == INVALID_JOY)
+			continue;
+		
+		Joystick_update(joy);
+		Joystick_process(joy);
+	}
+	
+	Joystick_any(aggregate);
+	Joystick_actions(joyset);
 }
 
 //------------------------------------------------------------------------------
 
 void Terminate()
 {
+	scan.finish(); // A deferred scan is dropped
+	Joystick_anydispose(aggregate);
+	
+	std::set<Joystick *>::iterator it;
+	for (it = joyset.begin(); it != joyset.end(); ++it)
+		Joystick_release(*it);
+	joyset.clear();
+	
+	for (size_t i = 0; i < map.size(); ++i)
+		delete map[i];
+	map.clear();
+	count = 0;
+	
+	if (initialized)
+		SDL_QuitSubSystem(SDL_INIT_JOYSTICK);
+	initialized = plugged = false;
+	devices = 0;
+	newest = -1;
+}
+
+//------------------------------------------------------------------------------
+
+bool Background(bool enable)
+{
+	// SDL's joystick functions belong to the thread that pumps the events
+	return !enable;
 }
 
 //==============================================================================
 
 int AGSJoystick::Dispose(const char *address, bool force)
 {
+	Joystick *joy = (Joystick *)address;
+	
+	// Never delete the fake joystick instance
+	if (joy == &dummy)
+		return 1;
+	
+	// Nor the aggregate, it is only closed
+	if (joy == &aggregate)
+	{
+		Joystick_anydispose(aggregate);
+		return 1;
+	}
+	
+	joyset.erase(joy);
+	
+	TRACE(TRACE_DELETED, joy->id, (intptr_t) joy);
+	Joystick_release(joy);
+	delete joy;
+	
 	return 1;
 }
 
@@ -45,47 +257,222 @@ int AGSJoystick::Dispose(const char *address, bool force)
 
 int AGSJoystick::Serialize(const char *address, char *buffer, int bufsize)
 {
-	return 0;
+	Joystick *joy = (Joystick *)address;
+	
+	if (joy->id == INVALID_JOY)
+		return 0;
+	
+	AGSJoySerial::Record serial;
+	serial.hash = (joy->id == JOY_ANY) ? RECORD_ANY : map[joy->id]->hash;
+	serial.events = joy->events;
+	serial.deadzone = joy->deadzone;
+	serial.threshold = joy->threshold;
+	serial.mask = joy->mask;
+	
+	PROBE2(save, joy->id, serial.hash);
+	return AGSJoySerial::Write(serial, buffer, bufsize);
 }
 
 //------------------------------------------------------------------------------
 
 void AGSJoystick::Unserialize(int key, const char *serializedData, int dataSize)
 {
+	AGSJoySerial::Record serial = { 0, 0, 0, JOY_THRESHOLD, JOY_EVENT_ALL };
+	Joystick_ready();
+	if (!AGSJoySerial::Read(serial, serializedData, dataSize))
+	{
+		// Savefile incompatible, damaged or a fake joy
+		AGS_RESTORE(Joystick, &dummy, key);
+		return;
+	}
+	
+	if (serial.hash == RECORD_ANY)
+	{
+		Joystick_anyrestore(aggregate, serial, key);
+		return;
+	}
+	
+	// Find previous used device
+	for (int i = 0; i < count; ++i)
+	{
+		if (serial.hash == map[i]->hash) // Found
+		{
+			// We do not return already open instances since this would probably
+			// cause problems with AGS' garbage collector.
+			// Simply create a new instance always
+			Joystick *joy = Joystick_create(i);
+			TRACE(TRACE_RESTORED, joy->id, (intptr_t) joy);
+			PROBE2(restore, joy->id, serial.hash);
+			joy->events = serial.events;
+			joy->deadzone = serial.deadzone;
+			joy->threshold = serial.threshold;
+			joy->mask = serial.mask;
+			joyset.insert(joy);
+			
+			AGS_RESTORE(Joystick, joy, key);
+			return;
+		}
+	}
+	
+	// Device no longer present, invalidate joystick
+	PROBE2(restore, INVALID_JOY, serial.hash);
+	AGS_RESTORE(Joystick, &dummy, key);
 }
 
 //==============================================================================
 
 long JoystickCount()
 {
-	return 0;
+	Joystick_ready();
+	return count;
 }
 
 //------------------------------------------------------------------------------
 
 long JoystickRescan()
 {
-	return 0;
+	Joystick_ready();
+	
+	// SDL reports devices as they come, a rescan without any finds nothing
+	Joystick_pump();
+	if (!plugged)
+		return 0;
+	plugged = false;
+	
+	PROFILE(STAGE_ENUMERATE);
+	long found = false;
+	int num = SDL_NumJoysticks();
+	
+	// Devices SDL no longer lists are gone, also those without a handle
+	// (Joystick_pump() only notices the attached ones)
+	for (int j = 0; j < count; ++j)
+	{
+		JoyDevice *dev = map[j];
+		if (dev->unplugged)
+			continue;
+		
+		int i = 0;
+		while (i < num && SDL_JoystickGetDeviceInstanceID(i) != dev->instance)
+			++i;
+		if (i == num)
+			Joystick_unplug(dev);
+	}
+	
+	for (int i = 0; i < num; ++i)
+	{
+		// Skip devices that are known and working
+		if (Joystick_device(SDL_JoystickGetDeviceInstanceID(i)))
+			continue;
+		
+		JoyDevice *dev = Joystick_probe(i);
+		if (!dev)
+			continue;
+		
+		// A device that was unplugged and came back keeps its old id
+		int j;
+		for (j = 0; j < count; ++j)
+			if (map[j]->unplugged && map[j]->ident == dev->ident)
+				break;
+		
+		if (j < count)
+		{
+			JoyDevice *old = map[j];
+			old->instance = dev->instance;
+			old->unplugged = false;
+			old->stamp = AGSJoyClock::Now();
+			if (old->refs || merging)
+				Joystick_attach(old);
+			delete dev;
+			AGSJoyStats::hotplug.add();
+			PROBE1(hotplug__add, j);
+			found = true;
+			continue;
+		}
+		
+		// Check for collisions (two devices with the same name and guid)
+		for (j = 0; j < count; ++j)
+			if (map[j]->hash == dev->hash)
+				dev->hash++;
+		
+		// New (working) device found
+		dev->index = count;
+		map.push_back(dev);
+		count++;
+		AGSJoyStats::hotplug.add();
+		PROBE1(hotplug__add, dev->index);
+		found = true;
+	}
+	
+	return found ? 1 : 0;
 }
 
 //------------------------------------------------------------------------------
 
 const char *JoystickName(long index)
 {
-	return "";
+	// Debug information (undocumented)
+	if (index == JOY_DEBUG_VERSION)
+		return AGS_STRING(PRODUCT_NAME " v" FILE_VERSION " SDL");
+	if (index == JOY_DEBUG_TRACE)
+	{
+		AGSJoyTrace::Dump();
+		return AGS_STRING("");
+	}
+	if (index <= JOY_DEBUG_LATENCY)
+		return AGS_STRING(AGSJoyStats::Report(index));
+	
+	Joystick_ready();
+	if ((index < 0) || (index >= count))
+		return AGS_STRING("");
+	
+	return AGS_STRING(map[index]->name.c_str());
 }
 
 //==============================================================================
 
 Joystick *Joystick_Open(long index)
 {
-	return NULL;
+	if (index == INVALID_JOY) // User requests a fake joystick instance
+	{
+		AGS_OBJECT(Joystick, &dummy);
+		return &dummy;
+	}
+	
+	// The aggregate walks the devices too, so it waits for the scan as well
+	Joystick_ready();
+	if (index == JOY_ANY) // One instance for all devices (see Any.h)
+		return Joystick_anyobject(aggregate);
+	
+	if ((index < 0) || (index >= count))
+		engine->AbortGame("!JoystickOpen: No device exists for specified index.");
+	
+	Joystick *joy;
+	
+	// Check if there is already an open instance, if so return it
+	if ((joy = Joystick_find(index)))
+		return joy;
+	
+	// Create a new joystick instance
+	joy = Joystick_create(index);
+	TRACE(TRACE_CREATED, joy->id, (intptr_t) joy);
+	
+	AGS_OBJECT(Joystick, joy);
+	joyset.insert(joy);
+	return joy;
 }
 
 //------------------------------------------------------------------------------
 
 long Joystick_IsOpen(long index)
 {
+	if (index == JOY_ANY)
+		return AGSJoyAny::Opened() ? 1 : 0;
+	
+	std::set<Joystick *>::iterator it;
+	for (it = joyset.begin(); it != joyset.end(); ++it)
+		if ((*it)->id == index)
+			return 1;
+	
 	return 0;
 }
 
@@ -93,65 +480,588 @@ long Joystick_IsOpen(long index)
 
 void Joystick_Click(long button)
 {
+	engine->SimulateMouseClick(button);
 }
 
 //==============================================================================
 
-void Joystick_Close(Joystick *)
+void Joystick_Close(Joystick *joy)
 {
+	joyset.erase(joy);
+	if (joy == &aggregate)
+	{
+		Joystick_anyclose(aggregate);
+		return;
+	}
+	
+	if (!joy || joy->id == INVALID_JOY)
+		return;
+	
+	Joystick_release(joy);
+	
+	memset(joy, 0, sizeof (Joystick));
+	joy->id = INVALID_JOY;
 }
 
 //------------------------------------------------------------------------------
 
-long Joystick_Valid(Joystick *)
+long Joystick_Valid(Joystick *joy)
 {
-	return 0;
+	if (!joy || joy->id == INVALID_JOY)
+		return 0;
+	
+	return 1;
 }
 
 //------------------------------------------------------------------------------
 
-long Joystick_Unplugged(Joystick *)
+long Joystick_Unplugged(Joystick *joy)
 {
-	return 1;
+	if (!joy || joy->id == INVALID_JOY)
+		return 0;
+	
+	if (joy->id == JOY_ANY)
+		return AGSJoyAny::Unplugged() ? 1 : 0;
+	
+	return map[joy->id]->unplugged ? 1 : 0;
 }
 
 //------------------------------------------------------------------------------
 
-const char *Joystick_GetName(Joystick *)
+const char *Joystick_GetName(Joystick *joy)
 {
-	return "";
+	if (joy->id == INVALID_JOY || joy->id == JOY_ANY)
+		return AGS_STRING("");
+	
+	return AGS_STRING(map[joy->id]->name.c_str());
 }
 
 //------------------------------------------------------------------------------
 
-long Joystick_GetAxis(Joystick *, long index)
+long Joystick_GetAxis(Joystick *joy, long index)
 {
-	return 0;
+	switch (index)
+	{
+		case 0: return (joy->x);
+		case 1: return (joy->y);
+		case 2: return (joy->z);
+		case 3: return (joy->u);
+		case 4: return (joy->v);
+		case 5: return (joy->w);
+		default:
+			engine->AbortGame("!GetAxis: No axis exists for specified index.");
+			return (0);
+	}
 }
 
 //------------------------------------------------------------------------------
 
-long Joystick_IsButtonDown(Joystick *, long button)
+long Joystick_IsButtonDown(Joystick *joy, long button)
 {
-	return 0;
+	return ((joy->buttons >> button) & 1);
+}
+
+//------------------------------------------------------------------------------
+
+void Joystick_Update(Joystick *joy)
+{
+	if (!Joystick_Valid(joy))
+		return;
+	
+	Joystick_pump();
+	if (joy->id == JOY_ANY)
+		Joystick_any(*joy);
+	else
+		Joystick_update(joy);
+}
+
+//------------------------------------------------------------------------------
+
+void Joystick_EnableEvents(Joystick *joy, long scope)
+{
+	// The aggregate has none, the devices' own instances raise them
+	if (!joy || joy->id == INVALID_JOY || joy->id == JOY_ANY)
+		return;
+	
+	joy->state->update(joy);
+	joy->events = scope ? 1 : 2;
+}
+
+//------------------------------------------------------------------------------
+
+void Joystick_DisableEvents(Joystick *joy)
+{
+	if (!joy || joy->id == INVALID_JOY)
+		return;
+	
+	joy->events = 0;
+}
+
+//------------------------------------------------------------------------------
+
+void Joystick_SetDeadzone(Joystick *joy, long deadzone)
+{
+	if (!joy || joy->id == INVALID_JOY)
+		return;
+	
+	joy->deadzone = (deadzone < 0) ? 0 : deadzone;
+}
+
+//------------------------------------------------------------------------------
+
+void Joystick_SetThreshold(Joystick *joy, long threshold)
+{
+	if (!joy || joy->id == INVALID_JOY)
+		return;
+	
+	joy->threshold = (threshold < 0) ? 0 : threshold;
+}
+
+//------------------------------------------------------------------------------
+
+void Joystick_SetEventMask(Joystick *joy, long mask)
+{
+	if (!joy || joy->id == INVALID_JOY)
+		return;
+	
+	joy->mask = mask & JOY_EVENT_ALL;
+}
+
+//------------------------------------------------------------------------------
+
+long Joystick_GetInputAge(Joystick *joy)
+{
+	if (!joy || joy->id == INVALID_JOY)
+		return 0;
+	
+	if (joy->id == JOY_ANY)
+		return AGSJoyAny::InputAge();
+	
+	uint64_t age = AGSJoyClock::Now() - joy->state->latched;
+	return (age > 0x7FFFFFFF) ? 0x7FFFFFFF : (long) age;
+}
+
+//------------------------------------------------------------------------------
+
+long Joystick_GetEventAge(Joystick *joy)
+{
+	if (!joy || joy->id == INVALID_JOY)
+		return 0;
+	
+	if (joy->id == JOY_ANY)
+		return AGSJoyAny::EventAge();
+	
+	uint64_t age = AGSJoyClock::Now() - joy->state->stamp;
+	return (age > 0x7FFFFFFF) ? 0x7FFFFFFF : (long) age;
+}
+
+//==============================================================================
+
+inline Joystick *Joystick_find(long index)
+{
+	std::set<Joystick *>::iterator it;
+	for (it = joyset.begin(); it != joyset.end(); ++it)
+		if ((*it)->id == index)
+			return *it;
+	
+	return NULL;
+}
+
+//------------------------------------------------------------------------------
+
+Joystick *Joystick_create(long index) // Pre: map[index] exists
+{
+	JoyDevice *dev = map[index];
+	
+	Joystick *joy = new Joystick;
+	memset(joy, 0, sizeof (Joystick));
+	
+	joy->id = index; // joystick id, not device index
+	joy->button_count = dev->button_count;
+	joy->axis_count = dev->axis_count;
+	joy->threshold = JOY_THRESHOLD;
+	joy->mask = JOY_EVENT_ALL;
+	
+	joy->state = new JoyState(dev);
+	AGSJoyMap::Attach(joy->pad, dev->guid);
+	Joystick_update(joy);
+	joy->state->update(joy);
+	
+	return joy;
+}
+
+//------------------------------------------------------------------------------
+
+void Joystick_release(Joystick *joy)
+{
+	if (joy->state)
+		delete joy->state;
+	joy->state = NULL;
+}
+
+//------------------------------------------------------------------------------
+
+void Joystick_update(Joystick *joy) // Pre: joy->id != INVALID_JOY
+{
+	JoyDevice &dev = *joy->state->dev;
+	
+	joy->x = dev.value[0]; joy->y = dev.value[1];
+	joy->z = dev.value[2]; joy->u = dev.value[3];
+	joy->v = dev.value[4]; joy->w = dev.value[5];
+	joy->buttons = dev.buttons;
+	joy->pov = dev.hat;
+	joy->state->stamp = dev.stamp;
+	joy->state->latched = AGSJoyClock::Now();
+	
+	if (joy->deadzone)
+	{
+		PROFILE(STAGE_FILTER);
+		int32_t *axis[] = { &joy->x, &joy->y, &joy->z, &joy->u, &joy->v, &joy->w };
+		for (int i = 0; i < JOY_AXES; ++i)
+			if ((*axis[i] < joy->deadzone) && (*axis[i] > -joy->deadzone))
+				*axis[i] = 0;
+	}
+	
+	AGSJoyMap::Apply(joy->pad, &joy->x, joy->pov, joy->buttons);
+}
+
+//------------------------------------------------------------------------------
+
+void Joystick_any(Joystick &joy)
+{
+	// SDL only keeps the state of opened joysticks: every device is opened
+	// while the aggregate is, the ones without instances are closed after
+	bool open = AGSJoyAny::Opened();
+	if (!open && merging)
+		for (int i = 0; i < count; ++i)
+			if (!map[i]->refs)
+				Joystick_detach(map[i]);
+	merging = open;
+	
+	if (!open)
+		return;
+	
+	AGSJoyAny::Begin(joy.deadzone);
+	for (int i = 0; i < count; ++i)
+	{
+		JoyDevice &dev = *map[i];
+		if (!dev.handle)
+			Joystick_attach(&dev);
+		if (dev.unplugged)
+			continue;
+		
+		AGSJoyAny::Device merged;
+		merged.button_count = dev.button_count;
+		merged.axis_count = dev.axis_count;
+		memcpy(merged.axis, dev.value, sizeof (merged.axis));
+		merged.pov = dev.hat;
+		merged.buttons = dev.buttons;
+		merged.stamp = dev.stamp;
+		merged.guid = dev.guid;
+		AGSJoyAny::Add(i, merged);
+	}
+	AGSJoyAny::End();
+	
+	Joystick_anycopy(joy);
+}
+
+//------------------------------------------------------------------------------
+
+#define JOY_START_AXIS_CHECK { int change;
+#define JOY_AXIS_CHECK(a,i) change = joy->a - last->a; \
+	if ((change > joy->threshold) || (change < -joy->threshold)) axes |= 1 << i;
+#define JOY_END_AXIS_CHECK }
+
+#define JOY_EVENT(e,v) { \
+	engine->QueueGameScriptFunction(e, joy->events - 1, 2, (long) joy, v); \
+	AGSJoyStats::latency.add(AGSJoyClock::Now() - last->stamp); \
+	AGSJoyStats::queued.add(); \
+	PROBE3(queue, joy->id, e, v); }
+
+void Joystick_process(Joystick *joy) // Pre: joy->id != INVALID_JOY
+{
+	if (!joy->events)
+		return;
+	
+	JoyState *&last = joy->state;
+	int axes = 0;
+	long pressed;
+	bool hat;
+	
+	{
+		PROFILE(STAGE_DETECT);
+		
+		JOY_START_AXIS_CHECK
+			JOY_AXIS_CHECK(x, 0)
+			JOY_AXIS_CHECK(y, 1)
+			JOY_AXIS_CHECK(z, 2)
+			JOY_AXIS_CHECK(u, 3)
+			JOY_AXIS_CHECK(v, 4)
+			JOY_AXIS_CHECK(w, 5)
+		JOY_END_AXIS_CHECK
+		
+		pressed = joy->buttons ^ last->buttons;
+		hat = joy->pov != last->pov;
+		
+		if (!(joy->mask & JOY_EVENT_MOVE))
+			axes = 0;
+		if (!(joy->mask & JOY_EVENT_PRESS))
+			pressed = 0;
+		if (!(joy->mask & JOY_EVENT_POV))
+			hat = false;
+	}
+	
+	if (!(axes || pressed || hat))
+		return;
+	
+	PROBE4(process, joy->id, axes, pressed, hat);
+	PROFILE(STAGE_DISPATCH);
+	
+	last->update(joy);
+	
+	{
+		int axis = 0;
+		
+		while (axes)
+		{
+			if (axes & 1)
+				JOY_EVENT("on_joy_move", axis);
+			
+			axes >>= 1;
+			axis++;
+		}
+	}
+	
+	{
+		int button = 0;
+		pressed &= joy->buttons; // ignore button releases
+		
+		while (pressed)
+		{
+			if (pressed & 1)
+				JOY_EVENT("on_joy_press", button);
+			
+			pressed >>= 1;
+			button++;
+		}
+	}
+	
+	if (hat)
+		JOY_EVENT("on_joy_pov", joy->pov);
+}
+
+//==============================================================================
+
+JoyDevice *Joystick_probe(int index)
+{
+	// Axis and button counts are only known once the device is opened; it is
+	// closed again until a joystick instance refers to it.
+	SDL_Joystick *handle = SDL_JoystickOpen(index);
+	if (!handle)
+		return NULL;
+	
+	JoyDevice *dev = new JoyDevice;
+	dev->instance = SDL_JoystickInstanceID(handle);
+	
+	const char *name = SDL_JoystickName(handle);
+	dev->name = name ? name : "Unknown joystick";
+	
+	dev->axis_count = SDL_JoystickNumAxes(handle);
+	if (dev->axis_count > JOY_AXES)
+		dev->axis_count = JOY_AXES;
+	dev->button_count = SDL_JoystickNumButtons(handle);
+	if (dev->button_count > JOY_BUTTONS)
+		dev->button_count = JOY_BUTTONS;
+	dev->hat_count = SDL_JoystickNumHats(handle);
+	
+	// FNV-1a hash algorithm over the name and guid
+	static const uint32_t basis = 2166136261UL;
+	static const uint32_t prime = 16777619UL;
+	
+	SDL_JoystickGUID guid = SDL_JoystickGetGUID(handle);
+	memcpy(dev->guid, guid.data, sizeof (dev->guid));
+	
+	uint32_t h = basis;
+	const unsigned char *ptr = (const unsigned char *) dev->name.c_str();
+	while (*ptr)
+		h = (*ptr++ ^ h) * prime;
+	
+	ptr = (const unsigned char *) &guid;
+	for (size_t i = 0; i < sizeof (guid); ++i)
+		h = (*ptr++ ^ h) * prime;
+	
+	dev->ident = dev->hash = h;
+	
+	SDL_JoystickClose(handle);
+	return dev;
+}
+
+//------------------------------------------------------------------------------
+
+JoyDevice *Joystick_device(SDL_JoystickID instance)
+{
+	if (instance < 0)
+		return NULL;
+	
+	for (int i = 0; i < count; ++i)
+		if (map[i]->instance == instance)
+			return map[i];
+	
+	return NULL;
+}
+
+//------------------------------------------------------------------------------
+
+void Joystick_attach(JoyDevice *dev)
+{
+	if (dev->handle || dev->unplugged)
+		return;
+	
+	// Device indices shift as devices come and go, the instance id does not
+	for (int i = 0, num = SDL_NumJoysticks(); i < num && !dev->handle; ++i)
+		if (SDL_JoystickGetDeviceInstanceID(i) == dev->instance)
+			dev->handle = SDL_JoystickOpen(i);
+	
+	if (!dev->handle)
+		return;
+	
+	Joystick_poll(dev);
+	dev->stamp = AGSJoyClock::Now();
+}
+
+//------------------------------------------------------------------------------
+
+void Joystick_detach(JoyDevice *dev)
+{
+	if (dev->handle)
+		SDL_JoystickClose(dev->handle);
+	dev->handle = NULL;
+}
+
+//------------------------------------------------------------------------------
+
+void Joystick_pump()
+{
+	if (!initialized)
+		return;
+	
+	PROFILE(STAGE_READ);
+	
+	// Pumping has SDL update the state of the opened joysticks and its list
+	// of devices. The event queue is the engine's, nothing is taken from it:
+	// devices coming and going show in that list (a device swapped for
+	// another as a new last instance), which asks for a rescan.
+	SDL_PumpEvents();
+	
+	int num = SDL_NumJoysticks();
+	SDL_JoystickID last = (num > 0) ? SDL_JoystickGetDeviceInstanceID(num - 1) : -1;
+	if (num != devices || last != newest)
+		plugged = true;
+	devices = num;
+	newest = last;
+	
+	uint64_t now = AGSJoyClock::Now();
+	for (int i = 0; i < count; ++i)
+	{
+		JoyDevice *dev = map[i];
+		if (!dev->handle)
+			continue;
+		
+		if (!SDL_JoystickGetAttached(dev->handle))
+		{
+			Joystick_unplug(dev);
+			continue;
+		}
+		
+		// Idle devices are polled less often, see Schedule.h
+		if (!dev->schedule.due())
+		{
+			AGSJoyStats::skipped.add();
+			continue;
+		}
+		
+		bool changed = Joystick_poll(dev);
+		dev->schedule.polled(changed);
+		if (changed)
+			dev->stamp = now;
+	}
 }
 
 //------------------------------------------------------------------------------
 
-void Joystick_Update(Joystick *)
+bool Joystick_poll(JoyDevice *dev) // Pre: dev->handle
 {
+	int32_t value[JOY_AXES] = { 0 };
+	for (int i = 0; i < dev->axis_count; ++i)
+		value[i] = SDL_JoystickGetAxis(dev->handle, i);
+	
+	uint32_t buttons = 0;
+	for (int i = 0; i < dev->button_count; ++i)
+		if (SDL_JoystickGetButton(dev->handle, i))
+			buttons |= 1UL << i;
+	
+	int32_t hat = (dev->hat_count > 0) ? SDL_JoystickGetHat(dev->handle, 0) : 0;
+	
+	if (!memcmp(value, dev->value, sizeof (value)) && buttons == dev->buttons && hat == dev->hat)
+		return false;
+	
+	memcpy(dev->value, value, sizeof (value));
+	dev->buttons = buttons;
+	dev->hat = hat;
+	return true;
 }
 
 //------------------------------------------------------------------------------
 
-void Joystick_EnableEvents(Joystick *, long scope)
+void Joystick_unplug(JoyDevice *dev)
 {
+	Joystick_detach(dev);
+	dev->instance = -1;
+	dev->unplugged = true;
+	
+	// Nothing is held, as on the other backends
+	memset(dev->value, 0, sizeof (dev->value));
+	dev->hat = 0;
+	dev->buttons = 0;
+	dev->stamp = AGSJoyClock::Now();
+	
+	TRACE(TRACE_UNPLUGGED, dev->index);
+	AGSJoyStats::hotplug.add();
+	PROBE1(hotplug__remove, dev->index);
 }
 
 //------------------------------------------------------------------------------
 
-void Joystick_DisableEvents(Joystick *)
+void Joystick_enumerate()
 {
+	PROFILE(STAGE_ENUMERATE);
+	
+	// The engine may run SDL already, the subsystem is reference counted
+	initialized = !SDL_InitSubSystem(SDL_INIT_JOYSTICK);
+	if (!initialized)
+		return;
+	SDL_JoystickEventState(SDL_ENABLE);
+	
+	// Detect devices
+	devices = SDL_NumJoysticks();
+	newest = (devices > 0) ? SDL_JoystickGetDeviceInstanceID(devices - 1) : -1;
+	for (int i = 0; i < devices; ++i)
+	{
+		JoyDevice *dev = Joystick_probe(i);
+		if (!dev)
+			continue;
+		
+		// Check for collisions (two devices with the same name and guid)
+		for (int j = 0; j < count; ++j)
+			if (map[j]->hash == dev->hash)
+				dev->hash++;
+		
+		dev->index = count;
+		map.push_back(dev);
+		++count;
+	}
+	
+	// SDL reports these as added too, so the first rescan looks (in vain)
 }
 
 //------------------------------------------------------------------------------
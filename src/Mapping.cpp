@@ -0,0 +1,680 @@
+/****************************************************************
+ * Controller mappings -- See header file for more information. *
+ ****************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32) || defined(_WINDOWS_)
+#	define WIN32_LEAN_AND_MEAN
+#	include <windows.h>
+#else
+#	include <fcntl.h>
+#	include <unistd.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#endif
+
+#include <algorithm>
+#include <map>
+
+#include "Mapping.h"
+#include "Serial.h"
+
+using AGSJoySerial::put16;
+using AGSJoySerial::put32;
+using AGSJoySerial::get16;
+using AGSJoySerial::get32;
+
+//------------------------------------------------------------------------------
+
+namespace AGSJoyMap {
+
+#if defined(_WIN32) || defined(_WINDOWS_)
+#	define MAPPING_PLATFORM "Windows"
+#elif defined(__APPLE__)
+#	define MAPPING_PLATFORM "Mac OS X"
+#else
+#	define MAPPING_PLATFORM "Linux"
+#endif
+
+#define MAPPING_PRESSED 16384 // Axis deflection that reads as a pressed button
+#define MAPPING_SEEDS   (1UL << 20) // Seeds tried per bucket before giving up
+
+// Names as in gamecontrollerdb.txt, in PadButton and PadAxis order
+const char *button_names[PAD_BUTTONS] =
+{
+	"a", "b", "x", "y", "back", "guide", "start", "leftstick", "rightstick",
+	"leftshoulder", "rightshoulder", "dpup", "dpdown", "dpleft", "dpright"
+};
+
+const char *axis_names[PAD_AXES] =
+{
+	"leftx", "lefty", "rightx", "righty", "lefttrigger", "righttrigger"
+};
+
+std::map<std::string, Mapping> entries; // By GUID, later mappings replace earlier
+std::vector<Mapping> table;             // Entries in key number order
+Index index;
+uint32_t generation = 1;                // Changes whenever the table does
+
+// Compiled database, when one is open
+const char *blob = NULL;
+size_t blob_size = 0;
+uint32_t blob_count, blob_buckets, blob_slots;
+
+//------------------------------------------------------------------------------
+
+uint32_t Hash(const uint8_t *guid, uint32_t seed)
+{
+	// FNV-1a with the seed folded into the basis, then MurmurHash3's
+	// finalizer: GUIDs differ in few bytes, this spreads them over all bits
+	uint32_t h = 2166136261UL ^ (seed * 0x9E3779B9UL);
+	for (int i = 0; i < 16; ++i)
+		h = (guid[i] ^ h) * 16777619UL;
+	
+	h ^= h >> 16; h *= 0x85EBCA6BUL;
+	h ^= h >> 13; h *= 0xC2B2AE35UL;
+	h ^= h >> 16;
+	return h;
+}
+
+//------------------------------------------------------------------------------
+
+bool Index::build(const std::vector<const uint8_t *> &keys)
+{
+	size_t count = keys.size();
+	seeds.assign(count / 2 + 1, 0);
+	slots.assign(count + count / 8 + 1, INDEX_EMPTY);
+	
+	std::vector<std::vector<uint32_t> > buckets(seeds.size());
+	for (size_t i = 0; i < count; ++i)
+		buckets[Hash(keys[i], 0) % seeds.size()].push_back((uint32_t) i);
+	
+	// Biggest buckets first, while most slots are still free
+	std::vector<std::pair<size_t, size_t> > order;
+	for (size_t b = 0; b < buckets.size(); ++b)
+		if (!buckets[b].empty())
+			order.push_back(std::make_pair(buckets[b].size(), b));
+	std::sort(order.rbegin(), order.rend());
+	
+	std::vector<uint32_t> taken;
+	for (size_t i = 0; i < order.size(); ++i)
+	{
+		const std::vector<uint32_t> &bucket = buckets[order[i].second];
+		uint32_t seed;
+		for (seed = 1; seed < MAPPING_SEEDS; ++seed)
+		{
+			taken.clear();
+			size_t j;
+			for (j = 0; j < bucket.size(); ++j)
+			{
+				uint32_t slot = Hash(keys[bucket[j]], seed) % slots.size();
+				if (slots[slot] != INDEX_EMPTY
+				|| std::find(taken.begin(), taken.end(), slot) != taken.end())
+					break;
+				taken.push_back(slot);
+			}
+			if (j == bucket.size())
+				break;
+		}
+		
+		if (seed == MAPPING_SEEDS)
+		{
+			seeds.clear();
+			slots.clear();
+			return false;
+		}
+		
+		seeds[order[i].second] = seed;
+		for (size_t j = 0; j < bucket.size(); ++j)
+			slots[taken[j]] = bucket[j];
+	}
+	
+	return true;
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t Index::candidate(const uint8_t *guid) const
+{
+	if (slots.empty())
+		return INDEX_EMPTY;
+	
+	uint32_t seed = seeds[Hash(guid, 0) % seeds.size()];
+	return slots[Hash(guid, seed) % slots.size()];
+}
+
+//==============================================================================
+
+int32_t Read(const Bind &bind, const int32_t *axes, int32_t pov, uint32_t buttons)
+{
+	switch (bind.type)
+	{
+		case BIND_BUTTON:
+			return ((buttons >> bind.index) & 1) ? 32767 : 0;
+		
+		case BIND_HAT:
+			return ((pov & bind.index) == bind.index) ? 32767 : 0;
+		
+		case BIND_AXIS:
+		{
+			int32_t value = axes[bind.index];
+			if (bind.flags & BIND_INVERT)
+				value = -1 - value;
+			
+			// Halves read as a deflection (0-32767)
+			if (bind.flags & BIND_HALF_POS)
+				return (value > 0) ? value : 0;
+			if (bind.flags & BIND_HALF_NEG)
+				return (value < 0) ? -1 - value : 0;
+			return value;
+		}
+		
+		default:
+			return 0;
+	}
+}
+
+//------------------------------------------------------------------------------
+
+// A full axis driving a trigger or half an axis is scaled to 0-32767
+int32_t Part(const Bind &bind, bool half, const int32_t *axes, int32_t pov, uint32_t buttons)
+{
+	int32_t value = Read(bind, axes, pov, buttons);
+	if (half && bind.type == BIND_AXIS && !(bind.flags & (BIND_HALF_POS | BIND_HALF_NEG)))
+		value = (value + 32768) >> 1;
+	return value;
+}
+
+//------------------------------------------------------------------------------
+
+void Attach(Pad &pad, const uint8_t *guid)
+{
+	memcpy(pad.guid, guid, sizeof (pad.guid));
+	pad.mapping = Find(pad.guid);
+	pad.generation = generation;
+	pad.buttons = 0;
+	memset(pad.axis, 0, sizeof (pad.axis));
+}
+
+//------------------------------------------------------------------------------
+
+void Apply(Pad &pad, const int32_t *axes, int32_t pov, uint32_t buttons)
+{
+	// Mappings added since the pad was set up may cover it now
+	if (pad.generation != generation)
+	{
+		pad.mapping = Find(pad.guid);
+		pad.generation = generation;
+	}
+	
+	const Mapping *map = pad.mapping;
+	pad.buttons = 0;
+	if (!map)
+	{
+		memset(pad.axis, 0, sizeof (pad.axis));
+		return;
+	}
+	
+	for (int i = 0; i < PAD_BUTTONS; ++i)
+	{
+		const Bind &bind = map->button[i];
+		int32_t value = Read(bind, axes, pov, buttons);
+		if ((bind.type == BIND_AXIS) ? (value > MAPPING_PRESSED) : (value != 0))
+			pad.buttons |= 1UL << i;
+	}
+	
+	for (int i = 0; i < PAD_AXES; ++i)
+	{
+		const Bind &pos = map->axis[i][0], &neg = map->axis[i][1];
+		bool trigger = (i >= PAD_TRIGGERLEFT);
+		int32_t value = 0;
+		
+		if (pos.type)
+			value += Part(pos, trigger || (pos.flags & BIND_TARGET), axes, pov, buttons);
+		if (neg.type)
+			value -= Part(neg, true, axes, pov, buttons);
+		
+		if (value > 32767)
+			value = 32767;
+		else if (value < (trigger ? 0 : -32768))
+			value = trigger ? 0 : -32768;
+		pad.axis[i] = value;
+	}
+}
+
+//==============================================================================
+
+int Hex(char c)
+{
+	if (c >= '0' && c <= '9') return c - '0';
+	if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+	return -1;
+}
+
+//------------------------------------------------------------------------------
+
+// Parses bN, aN, +aN, -aN, aN~ and h0.M (false for anything else)
+bool Source(const std::string &value, Bind &bind)
+{
+	const char *p = value.c_str();
+	memset(&bind, 0, sizeof (bind));
+	
+	if (*p == '+')
+		bind.flags |= BIND_HALF_POS, ++p;
+	else if (*p == '-')
+		bind.flags |= BIND_HALF_NEG, ++p;
+	
+	char kind = *p++;
+	char *end;
+	long number = strtol(p, &end, 10);
+	if (end == p || number < 0)
+		return false;
+	p = end;
+	
+	switch (kind)
+	{
+		case 'b':
+			if (bind.flags || number >= 32)
+				return false;
+			bind.type = BIND_BUTTON;
+			bind.index = (uint8_t) number;
+			break;
+		
+		case 'a':
+			if (number >= 6)
+				return false;
+			bind.type = BIND_AXIS;
+			bind.index = (uint8_t) number;
+			if (*p == '~')
+				bind.flags |= BIND_INVERT, ++p;
+			break;
+		
+		case 'h':
+		{
+			// Only hat 0 is exposed (as the pov)
+			if (bind.flags || number != 0 || *p++ != '.')
+				return false;
+			long mask = strtol(p, &end, 10);
+			if (end == p || mask < 1 || mask > 15)
+				return false;
+			p = end;
+			bind.type = BIND_HAT;
+			bind.index = (uint8_t) mask;
+			break;
+		}
+		
+		default:
+			return false;
+	}
+	
+	return *p == 0;
+}
+
+//------------------------------------------------------------------------------
+
+// One line: guid,name,target:source,...,platform:Name,
+bool Parse(const std::string &line, Mapping &map, const char *platform)
+{
+	memset(&map, 0, sizeof (map));
+	
+	size_t pos = line.find(',');
+	if (pos != 32)
+		return false;
+	
+	for (int i = 0; i < 16; ++i)
+	{
+		int high = Hex(line[i * 2]), low = Hex(line[i * 2 + 1]);
+		if (high < 0 || low < 0)
+			return false; // Also skips SDL's "xinput" entry
+		map.guid[i] = (uint8_t) (high << 4 | low);
+	}
+	
+	// Skip the name (which may not contain commas)
+	pos = line.find(',', pos + 1);
+	while (pos != std::string::npos && pos + 1 < line.size())
+	{
+		size_t next = line.find(',', pos + 1);
+		std::string field = line.substr(pos + 1, (next == std::string::npos) ? std::string::npos : next - pos - 1);
+		pos = next;
+		
+		size_t colon = field.find(':');
+		if (colon == std::string::npos)
+			continue;
+		
+		std::string target = field.substr(0, colon), value = field.substr(colon + 1);
+		if (target == "platform")
+		{
+			if (value != platform)
+				return false;
+			continue;
+		}
+		
+		Bind bind;
+		if (!Source(value, bind))
+			continue; // Unsupported input (more hats, axes or buttons)
+		
+		char half = 0;
+		if (target[0] == '+' || target[0] == '-')
+			half = target[0], target.erase(0, 1);
+		
+		for (int i = 0; i < PAD_BUTTONS; ++i)
+			if (!half && target == button_names[i])
+				map.button[i] = bind;
+		
+		for (int i = 0; i < PAD_AXES; ++i)
+			if (target == axis_names[i])
+			{
+				if (half)
+					bind.flags |= BIND_TARGET;
+				map.axis[i][(half == '-') ? 1 : 0] = bind;
+			}
+	}
+	
+	return true;
+}
+
+//------------------------------------------------------------------------------
+
+void Rebuild()
+{
+	table.clear();
+	table.reserve(entries.size());
+	std::vector<const uint8_t *> keys;
+	for (std::map<std::string, Mapping>::const_iterator it = entries.begin(); it != entries.end(); ++it)
+		table.push_back(it->second);
+	for (size_t i = 0; i < table.size(); ++i)
+		keys.push_back(table[i].guid);
+	
+	index.build(keys);
+	generation++;
+}
+
+//------------------------------------------------------------------------------
+
+long Add(const char *text)
+{
+	long added = 0;
+	const char *p = text;
+	while (p && *p)
+	{
+		const char *end = p + strcspn(p, "\r\n");
+		std::string line(p, end - p);
+		p = *end ? end + 1 : end;
+		
+		size_t start = line.find_first_not_of(" \t");
+		if (start == std::string::npos || line[start] == '#')
+			continue;
+		
+		Mapping map;
+		if (!Parse(line.substr(start), map, MAPPING_PLATFORM))
+			continue;
+		
+		entries[std::string((const char *) map.guid, sizeof (map.guid))] = map;
+		added++;
+	}
+	
+	if (added)
+		Rebuild();
+	return added;
+}
+
+//------------------------------------------------------------------------------
+
+long Load(const char *file)
+{
+	FILE *fp = fopen(file, "rb");
+	if (!fp)
+		return -1;
+	
+	char magic[4];
+	if (fread(magic, 1, sizeof (magic), fp) == sizeof (magic) && get32(magic) == BLOB_MAGIC)
+	{
+		fclose(fp);
+		return Open(file);
+	}
+	rewind(fp);
+	
+	std::string text;
+	char buffer[4096];
+	size_t size;
+	while ((size = fread(buffer, 1, sizeof (buffer), fp)) > 0)
+		text.append(buffer, size);
+	fclose(fp);
+	
+	return Add(text.c_str());
+}
+
+//------------------------------------------------------------------------------
+
+void Startup()
+{
+	// The compiled database is preferred, parsing text costs startup time
+	const char *file = getenv(MAPPING_ENV);
+	if (file)
+	{
+		if (*file)
+			Load(file);
+	}
+	else if (Load(MAPPING_BLOB) < 0)
+		Load(MAPPING_TEXT);
+	
+	if (const char *text = getenv(MAPPING_SDL_ENV))
+		Add(text);
+}
+
+//------------------------------------------------------------------------------
+
+void Clear()
+{
+	Close();
+	entries.clear();
+	table.clear();
+	index.seeds.clear();
+	index.slots.clear();
+	generation++;
+}
+
+//------------------------------------------------------------------------------
+
+const Mapping *Lookup(const uint8_t *guid)
+{
+	uint32_t key = index.candidate(guid);
+	if (key != INDEX_EMPTY && !memcmp(table[key].guid, guid, 16))
+		return &table[key];
+	
+	if (!blob)
+		return NULL;
+	
+	// The same as Index::candidate, on the mapped tables
+	const char *seeds = blob + BLOB_HEADER;
+	const char *slots = seeds + blob_buckets * 4;
+	uint32_t seed = get32(seeds + (Hash(guid, 0) % blob_buckets) * 4);
+	key = get32(slots + (Hash(guid, seed) % blob_slots) * 4);
+	if (key >= blob_count)
+		return NULL;
+	
+	const Mapping *map = (const Mapping *) (slots + blob_slots * 4 + key * MAPPING_SIZE);
+	return memcmp(map->guid, guid, 16) ? NULL : map;
+}
+
+const Mapping *Find(const uint8_t *guid)
+{
+	if (table.empty() && !blob)
+		return NULL;
+	
+	// Like SDL: exact, then without the name CRC, then also without version
+	const Mapping *map = Lookup(guid);
+	if (map)
+		return map;
+	
+	uint8_t loose[16];
+	memcpy(loose, guid, sizeof (loose));
+	loose[2] = loose[3] = 0;
+	if ((map = Lookup(loose)))
+		return map;
+	
+	loose[12] = loose[13] = 0;
+	return Lookup(loose);
+}
+
+//==============================================================================
+
+std::string Compile(const std::vector<Mapping> &maps, const char *platform)
+{
+	Index built;
+	std::vector<const uint8_t *> keys;
+	for (size_t i = 0; i < maps.size(); ++i)
+		keys.push_back(maps[i].guid);
+	if (strlen(platform) >= 16 || !built.build(keys))
+		return std::string();
+	
+	char head[BLOB_HEADER];
+	memset(head, 0, sizeof (head));
+	put32(head, BLOB_MAGIC);
+	put16(head + 4, BLOB_VERSION);
+	strcpy(head + 8, platform);
+	put32(head + 24, (uint32_t) maps.size());
+	put32(head + 28, (uint32_t) built.seeds.size());
+	put32(head + 32, (uint32_t) built.slots.size());
+	
+	std::string out(head, sizeof (head));
+	char value[4];
+	for (size_t i = 0; i < built.seeds.size(); ++i)
+		put32(value, built.seeds[i]), out.append(value, 4);
+	for (size_t i = 0; i < built.slots.size(); ++i)
+		put32(value, built.slots[i]), out.append(value, 4);
+	for (size_t i = 0; i < maps.size(); ++i)
+		out.append((const char *) &maps[i], MAPPING_SIZE);
+	
+	return out;
+}
+
+//------------------------------------------------------------------------------
+
+// Checks a mapped database: whole, and for this platform (or -1)
+long Check(const char *data, size_t size)
+{
+	if (size < BLOB_HEADER || get32(data) != BLOB_MAGIC || get16(data + 4) != BLOB_VERSION
+	|| strncmp(data + 8, MAPPING_PLATFORM, 16))
+		return -1;
+	
+	uint64_t count = get32(data + 24), buckets = get32(data + 28), slots = get32(data + 32);
+	if (!buckets || !slots || size != BLOB_HEADER + (buckets + slots) * 4 + count * MAPPING_SIZE)
+		return -1;
+	
+	return (long) count;
+}
+
+//------------------------------------------------------------------------------
+
+void Unmap(const char *data, size_t size)
+{
+	#if defined(_WIN32) || defined(_WINDOWS_)
+	UnmapViewOfFile(data);
+	#else
+	munmap((void *) data, size);
+	#endif
+}
+
+//------------------------------------------------------------------------------
+
+long Open(const char *file)
+{
+	// The view keeps the file open, the handles are not needed after that
+	#if defined(_WIN32) || defined(_WINDOWS_)
+	HANDLE fh = CreateFileA(file, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL, NULL);
+	if (fh == INVALID_HANDLE_VALUE)
+		return -1;
+	
+	LARGE_INTEGER info;
+	HANDLE mh = NULL;
+	const char *data = NULL;
+	if (GetFileSizeEx(fh, &info) && !info.HighPart && info.LowPart)
+		mh = CreateFileMappingA(fh, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mh)
+		data = (const char *) MapViewOfFile(mh, FILE_MAP_READ, 0, 0, 0), CloseHandle(mh);
+	CloseHandle(fh);
+	if (!data)
+		return -1;
+	size_t size = info.LowPart;
+	#else
+	int fd = open(file, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -1;
+	
+	struct stat info;
+	void *view = MAP_FAILED;
+	if (!fstat(fd, &info) && info.st_size > 0)
+		view = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (view == MAP_FAILED)
+		return -1;
+	const char *data = (const char *) view;
+	size_t size = info.st_size;
+	#endif
+	
+	// A bad file leaves the database that was open in place
+	long count = Check(data, size);
+	if (count < 0)
+	{
+		Unmap(data, size);
+		return -1;
+	}
+	
+	Close();
+	blob = data;
+	blob_size = size;
+	blob_count = get32(data + 24);
+	blob_buckets = get32(data + 28);
+	blob_slots = get32(data + 32);
+	generation++;
+	return count;
+}
+
+//------------------------------------------------------------------------------
+
+void Close()
+{
+	if (!blob)
+		return;
+	
+	Unmap(blob, blob_size);
+	blob = NULL;
+	blob_size = 0;
+	generation++;
+}
+
+//------------------------------------------------------------------------------
+
+const char *Platform()
+{
+	return MAPPING_PLATFORM;
+}
+
+//------------------------------------------------------------------------------
+
+void Guid(uint8_t *guid, uint16_t bus, uint16_t vendor, uint16_t product,
+	uint16_t version, const char *name)
+{
+	memset(guid, 0, 16);
+	put16((char *) guid, bus);
+	if (vendor && product)
+	{
+		put16((char *) guid + 4, vendor);
+		put16((char *) guid + 8, product);
+		put16((char *) guid + 12, version);
+	}
+	else if (name)
+		strncpy((char *) guid + 4, name, 12);
+}
+
+//------------------------------------------------------------------------------
+
+} /* namespace AGSJoyMap */
+
+//..............................................................................
@@ -0,0 +1,185 @@
+/*******************************************************
+ * Controller mappings -- header file                  *
+ *                                                     *
+ * Author: agent                                       *
+ *                                                     *
+ * Date: 20:15 19-10-2026                              *
+ *                                                     *
+ * Description: Standardized gamepad layout on top of  *
+ *              raw buttons and axes, using SDL's      *
+ *              gamecontrollerdb.txt mappings.         *
+ *******************************************************/
+
+#ifndef _MAPPING_H
+#define _MAPPING_H
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+/// Controller mappings
+namespace AGSJoyMap {
+
+//------------------------------------------------------------------------------
+// Standardized layout (see JoystickPadButton and JoystickPadAxis in the
+// script header). Axes range -32768..32767, triggers 0..32767.
+
+enum PadButton
+{
+	PAD_A, PAD_B, PAD_X, PAD_Y,
+	PAD_BACK, PAD_GUIDE, PAD_START,
+	PAD_LEFTSTICK, PAD_RIGHTSTICK,
+	PAD_LEFTSHOULDER, PAD_RIGHTSHOULDER,
+	PAD_DPUP, PAD_DPDOWN, PAD_DPLEFT, PAD_DPRIGHT,
+	PAD_BUTTONS
+};
+
+enum PadAxis
+{
+	PAD_LEFTX, PAD_LEFTY, PAD_RIGHTX, PAD_RIGHTY,
+	PAD_TRIGGERLEFT, PAD_TRIGGERRIGHT,
+	PAD_AXES
+};
+
+#define MAPPING_ENV     "AGSJOY_MAPPINGS"          // Mapping file, empty disables it
+#define MAPPING_SDL_ENV "SDL_GAMECONTROLLERCONFIG" // Extra mappings (text), as SDL
+#define MAPPING_TEXT    "gamecontrollerdb.txt"     // Default, in the game directory
+#define MAPPING_BLOB    "gamecontrollerdb.bin"     // Compiled, tried first
+
+//------------------------------------------------------------------------------
+// A binding reads one raw input: button N (bN), axis N (aN, +aN, -aN, aN~)
+// or hat 0 directions (h0.M, the same bits as the pov). Only what the
+// plugin exposes can be bound: 32 buttons, 6 axes and one hat.
+
+enum BindType { BIND_NONE, BIND_BUTTON, BIND_AXIS, BIND_HAT };
+
+#define BIND_HALF_POS 1 // +aN: positive half of the axis only
+#define BIND_HALF_NEG 2 // -aN: negative half of the axis only
+#define BIND_INVERT   4 // aN~
+#define BIND_TARGET   8 // +leftx, -leftx: drives half of the pad axis
+
+struct Bind
+{
+	uint8_t type;
+	uint8_t index; // Button or axis number, hat bits
+	uint8_t flags;
+	uint8_t reserved;
+};
+
+struct Mapping
+{
+	uint8_t guid[16];
+	Bind button[PAD_BUTTONS];
+	Bind axis[PAD_AXES][2]; // Full or positive half, negative half
+};
+
+#define MAPPING_SIZE (16 + PAD_BUTTONS * 4 + PAD_AXES * 8)
+
+// Bytes only, so the compiled database can hold them as they are in memory
+static_assert(sizeof (Mapping) == MAPPING_SIZE, "Mapping: layout changed");
+
+/// Parses one line for the given platform ("Linux", "Windows", "Mac OS X")
+bool Parse(const std::string &line, Mapping &map, const char *platform);
+
+/// The platform this is built for, as gamecontrollerdb.txt names it
+const char *Platform();
+
+//------------------------------------------------------------------------------
+// Perfect hash over GUIDs (hash and displace): a key's bucket picks the seed
+// that takes it to its slot, so a lookup is two hashes and one compare.
+
+#define INDEX_EMPTY 0xFFFFFFFFUL
+
+uint32_t Hash(const uint8_t *guid, uint32_t seed);
+
+struct Index
+{
+	std::vector<uint32_t> seeds; // Per bucket
+	std::vector<uint32_t> slots; // Key number or INDEX_EMPTY
+	
+	/// Builds the table, false when some bucket found no seed (not expected)
+	bool build(const std::vector<const uint8_t *> &keys);
+	
+	/// Returns the only key number that can match (or INDEX_EMPTY)
+	uint32_t candidate(const uint8_t *guid) const;
+};
+
+//------------------------------------------------------------------------------
+// Compiled database (see the joymap tool), mapped into memory as it is: a
+// lookup only touches the index and the one entry it leads to. Layout (all
+// fields little-endian):
+//
+//   offset  size  field
+//        0     4  magic     'AGJM'
+//        4     2  version   BLOB_VERSION
+//        6     2  reserved
+//        8    16  platform  name, zero padded (entries of other ones are left out)
+//       24     4  count     number of entries
+//       28     4  buckets   number of seeds
+//       32     4  slots     number of slots
+//       36        seeds     buckets times 4 bytes (see Index)
+//                 slots     slots times 4 bytes
+//                 entries   count times MAPPING_SIZE bytes (Mapping)
+
+#define BLOB_MAGIC   0x4D4A4741UL // 'AGJM'
+#define BLOB_VERSION 1
+#define BLOB_HEADER  36
+
+/// Builds a compiled database of unique mappings (empty when it fails)
+std::string Compile(const std::vector<Mapping> &maps, const char *platform);
+
+/// Maps a compiled database in place of the one before, returns the number
+/// of entries (-1 when it is none, damaged or for another platform; the one
+/// before is kept then)
+long Open(const char *file);
+void Close();
+
+//------------------------------------------------------------------------------
+// Per joystick state, refreshed by Apply every update
+
+struct Pad
+{
+	uint8_t guid[16];
+	const Mapping *mapping;  // NULL for unknown controllers
+	uint32_t generation;     // Table the mapping was taken from
+	uint32_t buttons;        // PadButton bits
+	int32_t axis[PAD_AXES];
+};
+
+/// Sets up a pad for the device with the given GUID
+void Attach(Pad &pad, const uint8_t *guid);
+
+/// Remaps the raw state (axes x-w in order, pov bits, button bits)
+void Apply(Pad &pad, const int32_t *axes, int32_t pov, uint32_t buttons);
+
+//------------------------------------------------------------------------------
+
+/// Adds mappings from text in gamecontrollerdb.txt format, returns how many
+long Add(const char *text);
+
+/// Adds the mappings in a file, returns how many (-1 when it can't be read).
+/// A compiled database replaces the one opened before; mappings added as
+/// text take precedence over it.
+long Load(const char *file);
+
+/// Loads the default mappings: $AGSJOY_MAPPINGS (or gamecontrollerdb.bin,
+/// or else gamecontrollerdb.txt) and $SDL_GAMECONTROLLERCONFIG
+void Startup();
+
+void Clear();
+
+/// Returns the mapping for a GUID (or NULL), trying SDL's looser matches too
+const Mapping *Find(const uint8_t *guid);
+
+/// Builds a GUID the way SDL does: from ids when known, the name otherwise
+void Guid(uint8_t *guid, uint16_t bus, uint16_t vendor, uint16_t product,
+	uint16_t version, const char *name);
+
+//------------------------------------------------------------------------------
+
+} /* namespace AGSJoyMap */
+
+#endif /* _MAPPING_H */
+
+//..............................................................................
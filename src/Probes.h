@@ -0,0 +1,49 @@
+/*******************************************************
+ * Static probes -- header file                        *
+ *                                                     *
+ * Author: agent                                       *
+ *                                                     *
+ * Date: 16:00 19-10-2026                              *
+ *                                                     *
+ * Description: USDT probe points for perf/bpftrace.   *
+ *              Compiled in with the USE_USDT option.  *
+ *******************************************************/
+
+#ifndef _PROBES_H
+#define _PROBES_H
+
+//------------------------------------------------------------------------------
+// Probes (provider "agsjoy"), arguments in order:
+//
+//   update__entry    open joysticks
+//   update__exit     microseconds spent
+//   read             joystick id, number of events (or reports) read
+//   process          joystick id, changed axes mask, changed buttons mask, pov changed
+//   queue            joystick id, script function name, argument
+//   hotplug__add     joystick id
+//   hotplug__remove  joystick id
+//   save             joystick id, device hash
+//   restore          joystick id (-1 when the device is gone), device hash
+//
+// Example: bpftrace -e 'usdt:./libagsjoy.so:agsjoy:queue { @[str(arg1)] = count(); }'
+
+#ifdef JOY_USDT
+#	include <sys/sdt.h>
+#	define PROBE(name)           DTRACE_PROBE(agsjoy, name)
+#	define PROBE1(name,a)        DTRACE_PROBE1(agsjoy, name, a)
+#	define PROBE2(name,a,b)      DTRACE_PROBE2(agsjoy, name, a, b)
+#	define PROBE3(name,a,b,c)    DTRACE_PROBE3(agsjoy, name, a, b, c)
+#	define PROBE4(name,a,b,c,d)  DTRACE_PROBE4(agsjoy, name, a, b, c, d)
+#else
+#	define PROBE(name)           ((void) 0)
+#	define PROBE1(name,a)        ((void) 0)
+#	define PROBE2(name,a,b)      ((void) 0)
+#	define PROBE3(name,a,b,c)    ((void) 0)
+#	define PROBE4(name,a,b,c,d)  ((void) 0)
+#endif
+
+//------------------------------------------------------------------------------
+
+#endif /* _PROBES_H */
+
+//..............................................................................
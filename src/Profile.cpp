@@ -0,0 +1,58 @@
+/************************************************************
+ * Stage profiler -- See header file for more information. *
+ ************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "Profile.h"
+
+//------------------------------------------------------------------------------
+
+namespace AGSJoyProfile {
+
+AGSJoyStats::Histogram stage[STAGES];
+
+#ifdef JOY_PROFILE
+static const char *names[STAGES] =
+{
+	"enumerate",
+	"read",
+	"calibrate",
+	"filter",
+	"detect",
+	"dispatch",
+};
+#endif
+
+//------------------------------------------------------------------------------
+
+const char *Report()
+{
+	static char buffer[2048];
+	
+	#ifndef JOY_PROFILE
+	strcpy(buffer, "profiling not compiled in (USE_PROFILE)");
+	#else
+	size_t len = 0;
+	*buffer = 0;
+	for (int i = 0; i < STAGES && len < sizeof (buffer); ++i)
+	{
+		int n = snprintf(buffer + len, sizeof (buffer) - len, "%s%s(ns) ",
+			i ? "\n" : "", names[i]);
+		if (n < 0)
+			break;
+		len += n;
+		if (len < sizeof (buffer))
+			len += stage[i].format(buffer + len, sizeof (buffer) - len);
+	}
+	#endif
+	
+	return buffer;
+}
+
+//------------------------------------------------------------------------------
+
+} /* namespace AGSJoyProfile */
+
+//..............................................................................
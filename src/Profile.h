@@ -0,0 +1,62 @@
+/*******************************************************
+ * Stage profiler -- header file                       *
+ *                                                     *
+ * Author: agent                                       *
+ *                                                     *
+ * Date: 16:45 19-10-2026                              *
+ *                                                     *
+ * Description: Scoped timers feeding a histogram per  *
+ *              update stage. Compiled in with the     *
+ *              USE_PROFILE option.                    *
+ *******************************************************/
+
+#ifndef _PROFILE_H
+#define _PROFILE_H
+
+#include "Clock.h"
+#include "Stats.h"
+
+/// Stage profiler
+namespace AGSJoyProfile {
+
+//------------------------------------------------------------------------------
+
+/// Profiled stages; the names are in Profile.cpp (keep them in sync!)
+enum Stage
+{
+	STAGE_ENUMERATE,  // Device detection (startup and rescans)
+	STAGE_READ,       // Reading device state
+	STAGE_CALIBRATE,  // Scaling raw values to the joystick range
+	STAGE_FILTER,     // Deadzones
+	STAGE_DETECT,     // Change detection for events
+	STAGE_DISPATCH,   // Queueing script events
+	STAGES
+};
+
+extern AGSJoyStats::Histogram stage[STAGES]; ///< Nanoseconds per stage
+
+/// Times its own lifetime
+struct Scope
+{
+	Stage id;
+	uint64_t start;
+	
+	Scope(Stage s) : id(s), start(AGSJoyClock::Ticks()) {}
+	~Scope() { stage[id].add(AGSJoyClock::Ticks() - start); }
+};
+
+const char *Report(); ///< Per stage breakdown
+
+//------------------------------------------------------------------------------
+
+} /* namespace AGSJoyProfile */
+
+#ifdef JOY_PROFILE
+#	define PROFILE(s) AGSJoyProfile::Scope profile_ ## s (AGSJoyProfile::s)
+#else
+#	define PROFILE(s) ((void) 0)
+#endif
+
+#endif /* _PROFILE_H */
+
+//..............................................................................
@@ -0,0 +1,232 @@
+/***********************************************************
+ * Batched reads -- See header file for more information. *
+ ***********************************************************/
+
+#include <string.h>
+
+#include "Ring.h"
+
+#ifdef JOY_URING
+#	include <errno.h>
+#	include <unistd.h>
+#	include <sys/mman.h>
+#	include <sys/syscall.h>
+#endif
+
+//------------------------------------------------------------------------------
+
+namespace AGSJoyRing {
+
+Ring::Ring() : fd(-1), enters(0)
+{
+}
+
+Ring::~Ring()
+{
+	close();
+}
+
+#ifdef JOY_URING
+
+//------------------------------------------------------------------------------
+// There is no glibc wrapper (and no liburing dependency), so these go
+// through syscall(). The ring indices are shared with the kernel.
+
+#define RING_LOAD(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define RING_STORE(p,v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+
+bool Ring::open(unsigned count)
+{
+	close();
+	
+	struct io_uring_params params;
+	memset(&params, 0, sizeof (params));
+	
+	fd = (int) syscall(__NR_io_uring_setup, count, &params);
+	if (fd < 0)
+	{
+		fd = -1;
+		return false;
+	}
+	
+	sq_size = params.sq_off.array + params.sq_entries * sizeof (unsigned);
+	cq_size = params.cq_off.cqes + params.cq_entries * sizeof (struct io_uring_cqe);
+	sqe_size = params.sq_entries * sizeof (struct io_uring_sqe);
+	
+	// Newer kernels map both rings with a single mmap
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+		sq_size = cq_size = (sq_size > cq_size) ? sq_size : cq_size;
+	
+	sq_ring = mmap(NULL, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+		fd, IORING_OFF_SQ_RING);
+	cq_ring = (params.features & IORING_FEAT_SINGLE_MMAP) ? sq_ring
+		: mmap(NULL, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+		fd, IORING_OFF_CQ_RING);
+	sqes = (struct io_uring_sqe *) mmap(NULL, sqe_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	
+	if (sq_ring == MAP_FAILED || cq_ring == MAP_FAILED || sqes == MAP_FAILED)
+	{
+		if (sqes != MAP_FAILED)
+			munmap(sqes, sqe_size);
+		if (cq_ring != MAP_FAILED && cq_ring != sq_ring)
+			munmap(cq_ring, cq_size);
+		if (sq_ring != MAP_FAILED)
+			munmap(sq_ring, sq_size);
+		::close(fd);
+		fd = -1;
+		return false;
+	}
+	
+	char *sq = (char *) sq_ring;
+	sq_head = (unsigned *) (sq + params.sq_off.head);
+	sq_tail = (unsigned *) (sq + params.sq_off.tail);
+	sq_mask = (unsigned *) (sq + params.sq_off.ring_mask);
+	sq_array = (unsigned *) (sq + params.sq_off.array);
+	
+	char *cq = (char *) cq_ring;
+	cq_head = (unsigned *) (cq + params.cq_off.head);
+	cq_tail = (unsigned *) (cq + params.cq_off.tail);
+	cq_mask = (unsigned *) (cq + params.cq_off.ring_mask);
+	cqes = (struct io_uring_cqe *) (cq + params.cq_off.cqes);
+	
+	entries = params.sq_entries;
+	queued = 0;
+	enters = 0;
+	return true;
+}
+
+//------------------------------------------------------------------------------
+
+void Ring::close()
+{
+	if (fd < 0)
+		return;
+	
+	munmap(sqes, sqe_size);
+	if (cq_ring != sq_ring)
+		munmap(cq_ring, cq_size);
+	munmap(sq_ring, sq_size);
+	::close(fd);
+	fd = -1;
+}
+
+//------------------------------------------------------------------------------
+
+struct io_uring_sqe *Ring::entry()
+{
+	if (fd < 0)
+		return NULL;
+	
+	unsigned tail = *sq_tail; // Only we write the tail
+	if (tail - RING_LOAD(sq_head) >= entries)
+		return NULL;
+	
+	unsigned index = tail & *sq_mask;
+	struct io_uring_sqe *sqe = &sqes[index];
+	memset(sqe, 0, sizeof (*sqe));
+	
+	sq_array[index] = index;
+	return sqe;
+}
+
+//------------------------------------------------------------------------------
+// The entry is handed to the kernel by moving the tail, after it is filled in.
+
+bool Ring::read(int file, void *buffer, unsigned size, void *data)
+{
+	struct io_uring_sqe *sqe = entry();
+	if (!sqe)
+		return false;
+	
+	sqe->opcode = IORING_OP_READ;
+	sqe->fd = file;
+	sqe->addr = (uint64_t) (uintptr_t) buffer;
+	sqe->len = size;
+	sqe->off = (uint64_t) -1; // Current file position (streams)
+	sqe->user_data = (uint64_t) (uintptr_t) data;
+	
+	RING_STORE(sq_tail, *sq_tail + 1);
+	queued++;
+	return true;
+}
+
+//------------------------------------------------------------------------------
+
+bool Ring::cancel(void *data)
+{
+	struct io_uring_sqe *sqe = entry();
+	if (!sqe)
+		return false;
+	
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->fd = -1;
+	sqe->addr = (uint64_t) (uintptr_t) data; // user_data of the read
+	sqe->user_data = 0;
+	
+	RING_STORE(sq_tail, *sq_tail + 1);
+	queued++;
+	return true;
+}
+
+//------------------------------------------------------------------------------
+
+int Ring::submit(unsigned wait)
+{
+	if (fd < 0 || (!queued && !wait))
+		return 0;
+	
+	int result;
+	do
+	{
+		enters++;
+		result = (int) syscall(__NR_io_uring_enter, fd, queued, wait,
+			wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+	}
+	while (result < 0 && errno == EINTR);
+	
+	if (result > 0)
+		queued -= ((unsigned) result > queued) ? queued : (unsigned) result;
+	return result;
+}
+
+//------------------------------------------------------------------------------
+
+int Ring::reap(Completion *out, int max)
+{
+	if (fd < 0)
+		return 0;
+	
+	unsigned head = *cq_head; // Only we write the head
+	unsigned tail = RING_LOAD(cq_tail);
+	int n = 0;
+	
+	for (; head != tail && n < max; ++head, ++n)
+	{
+		struct io_uring_cqe *cqe = &cqes[head & *cq_mask];
+		out[n].data = (void *) (uintptr_t) cqe->user_data;
+		out[n].result = cqe->res;
+	}
+	
+	RING_STORE(cq_head, head);
+	return n;
+}
+
+//------------------------------------------------------------------------------
+
+#else /* JOY_URING */
+
+bool Ring::open(unsigned /*count*/) { return false; }
+void Ring::close() {}
+bool Ring::read(int /*file*/, void * /*buffer*/, unsigned /*size*/, void * /*data*/) { return false; }
+bool Ring::cancel(void * /*data*/) { return false; }
+int Ring::submit(unsigned /*wait*/) { return 0; }
+int Ring::reap(Completion * /*out*/, int /*max*/) { return 0; }
+
+#endif /* JOY_URING */
+
+//------------------------------------------------------------------------------
+
+} /* namespace AGSJoyRing */
+
+//..............................................................................
@@ -0,0 +1,85 @@
+/*******************************************************
+ * Batched reads -- header file                        *
+ *                                                     *
+ * Author: agent                                       *
+ *                                                     *
+ * Date: 16:20 19-10-2026                              *
+ *                                                     *
+ * Description: Minimal io_uring submission and        *
+ *              completion ring for device reads.      *
+ *******************************************************/
+
+#ifndef _RING_H
+#define _RING_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef JOY_URING
+#	include <linux/io_uring.h>
+#endif
+
+/// Batched reads
+namespace AGSJoyRing {
+
+//------------------------------------------------------------------------------
+// A read is posted once per device and stays in flight until input arrives,
+// so reaping completions only touches shared memory. The one system call left
+// is the submit that posts the reads again, one for all devices.
+//
+// Files must be in blocking mode: io_uring completes a read on a non-blocking
+// file right away with -EAGAIN instead of waiting for data.
+
+struct Completion
+{
+	void *data;     // As passed to read()
+	int32_t result; // Bytes read or -errno
+};
+
+struct Ring
+{
+	int fd;
+	uint32_t enters; // io_uring_enter calls made (for benchmarks)
+	
+	Ring();
+	~Ring();
+	
+	bool open(unsigned entries); ///< Sets up the ring, false if unsupported
+	void close();                ///< Pre: no reads in flight (see cancel)
+	bool opened() const { return fd >= 0; }
+	
+	/// Queues a read (it is posted by the next submit), false if full
+	bool read(int file, void *buffer, unsigned size, void *data);
+	
+	/// Queues a cancel of the read posted with data, false if full. The read
+	/// still completes (with what it got or -ECANCELED), the cancel itself
+	/// completes with data NULL.
+	bool cancel(void *data);
+	
+	/// Posts queued reads, and optionally waits for that many completions
+	int submit(unsigned wait = 0);
+	
+	/// Collects up to max completions without a system call
+	int reap(Completion *out, int max);
+	
+	#ifdef JOY_URING
+	unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+	unsigned *cq_head, *cq_tail, *cq_mask;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+	void *sq_ring, *cq_ring;
+	size_t sq_size, cq_size, sqe_size;
+	unsigned entries;
+	unsigned queued;  // Reads queued but not yet submitted
+	
+	struct io_uring_sqe *entry(); // Next free submission entry (or NULL)
+	#endif
+};
+
+//------------------------------------------------------------------------------
+
+} /* namespace AGSJoyRing */
+
+#endif /* _RING_H */
+
+//..............................................................................
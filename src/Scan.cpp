@@ -0,0 +1,253 @@
+/*********************************************************
+ * Device scan -- See header file for more information. *
+ *********************************************************/
+
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <memory>
+#include <system_error>
+
+#include "Scan.h"
+
+//------------------------------------------------------------------------------
+
+namespace AGSJoyScan {
+
+typedef std::chrono::steady_clock Clock;
+
+enum TaskState { TASK_QUEUED, TASK_RUNNING, TASK_DONE, TASK_ABANDONED };
+
+/// Shared by Parallel() and its workers; outlives whichever is last
+struct Batch
+{
+	std::mutex lock;
+	std::condition_variable cond;
+	std::vector<Task *> tasks;
+	std::vector<int> state;             // TaskState
+	std::vector<Clock::time_point> due; // Deadline of a running task
+	std::vector<size_t> worker;         // Worker running it
+	size_t next;    // First task no worker has taken yet
+	size_t pending; // Tasks neither finished nor abandoned
+	size_t live;    // Workers not stuck on an abandoned task
+	Clock::duration timeout;
+};
+
+/// Workers stuck on abandoned tasks, joined by Join(). Whatever
+/// is left at exit (no Terminate) is let go rather than aborting the process.
+static struct Stragglers
+{
+	std::mutex lock;
+	std::vector<std::thread> threads;
+	
+	~Stragglers()
+	{
+		for (size_t i = 0; i < threads.size(); ++i)
+			threads[i].detach();
+	}
+} stragglers;
+
+static void Worker(std::shared_ptr<Batch> batch, size_t slot)
+{
+	std::unique_lock<std::mutex> guard(batch->lock);
+	while (batch->next < batch->tasks.size())
+	{
+		// The deadline starts when the task does, not with the batch
+		size_t index = batch->next++;
+		Task *task = batch->tasks[index];
+		batch->state[index] = TASK_RUNNING;
+		batch->due[index] = Clock::now() + batch->timeout;
+		batch->worker[index] = slot;
+		batch->cond.notify_one();
+		
+		guard.unlock();
+		task->run();
+		guard.lock();
+		
+		// Too late: a replacement took over the rest of the queue
+		if (batch->state[index] == TASK_ABANDONED)
+		{
+			delete task;
+			return;
+		}
+		
+		batch->state[index] = TASK_DONE;
+		if (!--batch->pending)
+			batch->cond.notify_one();
+	}
+}
+
+/// Starts a worker, false when out of threads (Pre: batch->lock held)
+static bool Spawn(std::shared_ptr<Batch> &batch, std::vector<std::thread> &workers)
+{
+	try
+	{
+		workers.push_back(std::thread(Worker, batch, workers.size()));
+	}
+	catch (const std::system_error &)
+	{
+		return false;
+	}
+	
+	batch->live++;
+	return true;
+}
+
+//------------------------------------------------------------------------------
+
+void Parallel(std::vector<Task *> &tasks, unsigned timeout)
+{
+	if (tasks.empty())
+		return;
+	
+	std::shared_ptr<Batch> batch(new Batch);
+	batch->tasks = tasks;
+	batch->state.assign(tasks.size(), TASK_QUEUED);
+	batch->due.resize(tasks.size());
+	batch->worker.assign(tasks.size(), 0);
+	batch->next = 0;
+	batch->pending = tasks.size();
+	batch->live = 0;
+	batch->timeout = std::chrono::milliseconds(timeout);
+	
+	std::vector<std::thread> workers;
+	std::vector<bool> stuck;
+	std::unique_lock<std::mutex> guard(batch->lock);
+	
+	size_t size = (tasks.size() < SCAN_WORKERS) ? tasks.size() : SCAN_WORKERS;
+	while (workers.size() < size && Spawn(batch, workers));
+	
+	if (workers.empty())
+	{
+		guard.unlock();
+		Worker(batch, 0); // Out of threads: probe them here
+		return;
+	}
+	
+	while (batch->pending)
+	{
+		// Sleep until something finishes or the first running task is due
+		Clock::time_point wake = Clock::now() + batch->timeout;
+		for (size_t i = 0; i < tasks.size(); ++i)
+			if (batch->state[i] == TASK_RUNNING && batch->due[i] < wake)
+				wake = batch->due[i];
+		batch->cond.wait_until(guard, wake);
+		
+		// A task past its deadline is abandoned (it cleans up after itself)
+		// and its worker replaced, so the tasks queued behind it still run
+		Clock::time_point now = Clock::now();
+		for (size_t i = 0; i < tasks.size(); ++i)
+		{
+			if (batch->state[i] != TASK_RUNNING || now < batch->due[i])
+				continue;
+			
+			batch->state[i] = TASK_ABANDONED;
+			batch->pending--;
+			batch->live--;
+			tasks[i] = NULL;
+			
+			stuck.resize(workers.size(), false);
+			stuck[batch->worker[i]] = true;
+			if (batch->next < tasks.size())
+				Spawn(batch, workers);
+		}
+		
+		// Without workers the queued tasks are dropped
+		if (!batch->live)
+		{
+			for (size_t i = batch->next; i < tasks.size(); ++i)
+			{
+				delete tasks[i];
+				tasks[i] = NULL;
+				batch->pending--;
+			}
+			batch->next = tasks.size();
+		}
+	}
+	guard.unlock();
+	
+	stuck.resize(workers.size(), false);
+	std::lock_guard<std::mutex> hold(stragglers.lock);
+	for (size_t i = 0; i < workers.size(); ++i)
+	{
+		if (stuck[i])
+			stragglers.threads.push_back(std::move(workers[i]));
+		else
+			workers[i].join();
+	}
+}
+
+//------------------------------------------------------------------------------
+
+void Join()
+{
+	std::vector<std::thread> threads;
+	{
+		std::lock_guard<std::mutex> hold(stragglers.lock);
+		threads.swap(stragglers.threads);
+	}
+	
+	for (size_t i = 0; i < threads.size(); ++i)
+		threads[i].join();
+}
+
+//------------------------------------------------------------------------------
+
+static void Runner(Job *job, void (*function)())
+{
+	function();
+	job->finished = true;
+}
+
+void Job::start(void (*function)())
+{
+	finish();
+	finished = false;
+	
+	try
+	{
+		thread = std::thread(Runner, this, function);
+	}
+	catch (const std::system_error &)
+	{
+		Runner(this, function);
+	}
+}
+
+//------------------------------------------------------------------------------
+
+void Job::defer(void (*function)())
+{
+	finish();
+	deferred = function;
+}
+
+//------------------------------------------------------------------------------
+
+void Job::wait()
+{
+	if (deferred)
+	{
+		void (*function)() = deferred;
+		deferred = NULL;
+		finished = false;
+		Runner(this, function);
+	}
+	
+	if (thread.joinable())
+		thread.join();
+}
+
+//------------------------------------------------------------------------------
+
+void Job::finish()
+{
+	deferred = NULL;
+	wait();
+}
+
+//------------------------------------------------------------------------------
+
+} /* namespace AGSJoyScan */
+
+//..............................................................................
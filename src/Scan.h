@@ -0,0 +1,69 @@
+/*******************************************************
+ * Device scan -- header file                          *
+ *                                                     *
+ * Author: agent                                       *
+ *                                                     *
+ * Date: 17:30 19-10-2026                              *
+ *                                                     *
+ * Description: Background enumeration, probing the    *
+ *              devices in parallel with a deadline.   *
+ *******************************************************/
+
+#ifndef _SCAN_H
+#define _SCAN_H
+
+#include <vector>
+#include <thread>
+#include <atomic>
+
+/// Device scan
+namespace AGSJoyScan {
+
+//------------------------------------------------------------------------------
+
+#define SCAN_TIMEOUT 1500 // Milliseconds a device may take to probe
+#define SCAN_WORKERS 4    // Threads probing at once
+
+/// Work item for Parallel(); one that misses its deadline is abandoned and
+/// deleted, by its worker once it does finish (so the destructor should
+/// release whatever run() acquired).
+struct Task
+{
+	virtual ~Task() {}
+	virtual void run() = 0;
+};
+
+/// Runs the tasks on up to SCAN_WORKERS threads and waits for them. A task
+/// gets timeout milliseconds from when a worker starts it; one that takes
+/// longer is replaced by NULL and its worker, left for Join(), by a new one.
+void Parallel(std::vector<Task *> &tasks, unsigned timeout = SCAN_TIMEOUT);
+
+/// Waits for the workers that Parallel() left running
+void Join();
+
+//------------------------------------------------------------------------------
+
+/// A function run once in the background that callers can wait for
+struct Job
+{
+	std::thread thread;
+	std::atomic<bool> finished;
+	void (*deferred)();
+	
+	Job() : finished(true), deferred(NULL) {}
+	~Job() { finish(); }
+	
+	void start(void (*function)()); ///< Runs it right away if there are no threads
+	void defer(void (*function)()); ///< Runs it on the first wait() instead (lazy)
+	void wait();                    ///< Blocks until it has finished
+	void finish();                  ///< Like wait(), but drops a deferred run
+	bool done() const { return finished.load() && !deferred; } ///< False while a deferred run is pending
+};
+
+//------------------------------------------------------------------------------
+
+} /* namespace AGSJoyScan */
+
+#endif /* _SCAN_H */
+
+//..............................................................................
@@ -0,0 +1,92 @@
+/*******************************************************
+ * Poll scheduler -- header file                       *
+ *                                                     *
+ * Author: agent                                       *
+ *                                                     *
+ * Date: 15:10 19-10-2026                              *
+ *                                                     *
+ * Description: Backs off polling of idle devices for  *
+ *              backends that cannot wait for events.  *
+ *******************************************************/
+
+#ifndef _SCHEDULE_H
+#define _SCHEDULE_H
+
+#include <stdint.h>
+
+/// Poll scheduler
+namespace AGSJoySchedule {
+
+//------------------------------------------------------------------------------
+// A device is polled on every update until it has been idle (its state did
+// not change) for SCHEDULE_IDLE polls. From then on the interval doubles every
+// SCHEDULE_IDLE polls up to SCHEDULE_MAX updates. Any change, or a wake() from
+// a status check that saw activity, brings it back to full rate.
+//
+// The interval is kept short: a backend that cannot see events pending misses
+// a press shorter than it, so this only halves the polls of a quiet device.
+//
+// Note: the state must not change at all to count as idle, so an analog stick
+// that jitters around its center keeps the device awake unless a deadzone
+// is set.
+
+#define SCHEDULE_IDLE 60 // Unchanged polls before backing off
+#define SCHEDULE_MAX  2  // Longest interval between polls (in updates)
+
+struct Poll
+{
+	uint32_t idle; // Consecutive polls without a change
+	uint32_t wait; // Updates left until the next poll
+	
+	Poll() : idle(0), wait(0) {}
+	
+	/// Returns true when the device should be polled this update
+	inline bool due()
+	{
+		if (!wait)
+			return true;
+		
+		--wait;
+		return false;
+	}
+	
+	/// Call after a poll, with whether the device state changed
+	inline void polled(bool changed)
+	{
+		if (changed)
+			idle = 0;
+		else if (idle < SCHEDULE_IDLE * SCHEDULE_MAX)
+			++idle;
+		
+		wait = interval() - 1;
+	}
+	
+	/// Poll again on the next update
+	inline void wake()
+	{
+		idle = wait = 0;
+	}
+	
+	/// Whether the device is being polled at a reduced rate
+	inline bool idling() const
+	{
+		return idle >= SCHEDULE_IDLE;
+	}
+	
+	/// Current number of updates between polls
+	inline uint32_t interval() const
+	{
+		uint32_t n = 1;
+		for (uint32_t i = idle; i >= SCHEDULE_IDLE && n < SCHEDULE_MAX; i -= SCHEDULE_IDLE)
+			n <<= 1;
+		return n;
+	}
+};
+
+//------------------------------------------------------------------------------
+
+} /* namespace AGSJoySchedule */
+
+#endif /* _SCHEDULE_H */
+
+//..............................................................................
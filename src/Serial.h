@@ -0,0 +1,136 @@
+/*******************************************************
+ * Save game record -- header file                     *
+ *                                                     *
+ * Author: agent                                       *
+ *                                                     *
+ * Date: 10:20 19-10-2026                              *
+ *                                                     *
+ * Description: Versioned, fixed-width, little-endian  *
+ *              save record for joystick objects.      *
+ *******************************************************/
+
+#ifndef _SERIAL_H
+#define _SERIAL_H
+
+#include <stdint.h>
+#include <string.h>
+
+/// Save game record
+namespace AGSJoySerial {
+
+//------------------------------------------------------------------------------
+// Record layout (all fields little-endian):
+//
+//   offset  size  field
+//        0     4  magic     'AGSJ'
+//        4     2  version   RECORD_VERSION
+//        6     2  size      total record size in bytes
+//        8     4  hash      device hash
+//       12     4  events    event scope (0 = off, 1 = room, 2 = global)
+//       16     4  deadzone  axis deadzone
+//       20     4  threshold minimal axis change for move events
+//       24     4  mask      event mask
+//
+// Newer versions may only append fields; readers skip what they don't know.
+// Records written before versioning are two native longs (hash, events):
+// 8 bytes on Win32 and 16 bytes on LP64 systems. Both are still accepted.
+
+#define RECORD_MAGIC   0x4A534741UL // 'AGSJ'
+#define RECORD_VERSION 1
+#define RECORD_SIZE    28
+#define RECORD_ANY     0xFFFFFFFDUL // Hash of the aggregate (JOY_ANY), not a device
+
+struct Record
+{
+	uint32_t hash;
+	int32_t  events;
+	int32_t  deadzone;
+	int32_t  threshold;
+	uint32_t mask;
+};
+
+//------------------------------------------------------------------------------
+
+inline void put16(char *p, uint32_t v)
+{
+	p[0] = (char) v; p[1] = (char) (v >> 8);
+}
+
+inline void put32(char *p, uint32_t v)
+{
+	p[0] = (char) v; p[1] = (char) (v >> 8);
+	p[2] = (char) (v >> 16); p[3] = (char) (v >> 24);
+}
+
+inline uint32_t get16(const char *p)
+{
+	const unsigned char *u = (const unsigned char *) p;
+	return u[0] | (u[1] << 8);
+}
+
+inline uint32_t get32(const char *p)
+{
+	const unsigned char *u = (const unsigned char *) p;
+	return u[0] | (u[1] << 8) | (u[2] << 16) | ((uint32_t) u[3] << 24);
+}
+
+//------------------------------------------------------------------------------
+
+/// Writes a record, returns the number of bytes written (0 if it won't fit)
+inline int Write(const Record &rec, char *buffer, int bufsize)
+{
+	if (bufsize < RECORD_SIZE)
+		return 0;
+
+	put32(buffer +  0, RECORD_MAGIC);
+	put16(buffer +  4, RECORD_VERSION);
+	put16(buffer +  6, RECORD_SIZE);
+	put32(buffer +  8, rec.hash);
+	put32(buffer + 12, (uint32_t) rec.events);
+	put32(buffer + 16, (uint32_t) rec.deadzone);
+	put32(buffer + 20, (uint32_t) rec.threshold);
+	put32(buffer + 24, rec.mask);
+
+	return RECORD_SIZE;
+}
+
+//------------------------------------------------------------------------------
+
+/// Reads a record; fields missing from older formats keep the values
+/// already present in rec (so callers should fill in defaults first).
+/// Returns false when the data is not a joystick record.
+inline bool Read(Record &rec, const char *data, int size)
+{
+	// Legacy: native long pair (Win32 / LP64)
+	if (size == 8 || size == 16)
+	{
+		const int stride = size / 2;
+		rec.hash = get32(data);
+		rec.events = (int32_t) get32(data + stride);
+		return true;
+	}
+
+	if (size < 8 || get32(data) != RECORD_MAGIC)
+		return false;
+
+	int length = (int) get16(data + 6);
+	if (length > size || get16(data + 4) < 1 || length < RECORD_SIZE)
+		return false;
+
+	// Version 1 fields
+	rec.hash      = get32(data +  8);
+	rec.events    = (int32_t) get32(data + 12);
+	rec.deadzone  = (int32_t) get32(data + 16);
+	rec.threshold = (int32_t) get32(data + 20);
+	rec.mask      = get32(data + 24);
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+
+} /* namespace AGSJoySerial */
+
+#endif /* _SERIAL_H */
+
+//..............................................................................
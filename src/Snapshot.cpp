@@ -0,0 +1,74 @@
+/***********************************************************
+ * State snapshot -- See header file for more information. *
+ ***********************************************************/
+
+#include <string.h>
+
+#include "Snapshot.h"
+#include "Serial.h"
+
+//------------------------------------------------------------------------------
+
+namespace AGSJoySnapshot {
+
+using namespace AGSJoySerial;
+
+//------------------------------------------------------------------------------
+
+JoystickState *Create()
+{
+	JoystickState *state = new JoystickState;
+	memset(state, 0, sizeof (JoystickState));
+	state->id = INVALID_JOY;
+	AGS_OBJECT(JoystickState, state);
+	return state;
+}
+
+//==============================================================================
+
+int AGSJoystickState::Dispose(const char *address, bool /*force*/)
+{
+	delete (JoystickState *) address;
+	return 1;
+}
+
+//------------------------------------------------------------------------------
+
+int AGSJoystickState::Serialize(const char *address, char *buffer, int bufsize)
+{
+	// A snapshot is plain data: every field as it is, little-endian
+	if (bufsize < STATE_SIZE)
+		return 0;
+	
+	uint32_t fields[STATE_FIELDS];
+	memcpy(fields, address, STATE_SIZE);
+	for (int i = 0; i < STATE_FIELDS; ++i)
+		put32(buffer + i * 4, fields[i]);
+	return STATE_SIZE;
+}
+
+//------------------------------------------------------------------------------
+
+void AGSJoystickState::Unserialize(int key, const char *serializedData, int dataSize)
+{
+	JoystickState *state = new JoystickState;
+	memset(state, 0, sizeof (JoystickState));
+	state->id = INVALID_JOY;
+	
+	// Anything else was not written by us, it restores as an empty snapshot
+	if (dataSize == STATE_SIZE)
+	{
+		uint32_t fields[STATE_FIELDS];
+		for (int i = 0; i < STATE_FIELDS; ++i)
+			fields[i] = get32(serializedData + i * 4);
+		memcpy(state, fields, STATE_SIZE);
+	}
+	
+	AGS_RESTORE(JoystickState, state, key);
+}
+
+//------------------------------------------------------------------------------
+
+} /* namespace AGSJoySnapshot */
+
+//..............................................................................
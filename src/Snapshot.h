@@ -0,0 +1,61 @@
+/*******************************************************
+ * State snapshot -- header file                       *
+ *                                                     *
+ * Author: agent                                       *
+ *                                                     *
+ * Date: 22:35 19-10-2026                              *
+ *                                                     *
+ * Description: Managed object holding the complete    *
+ *              state of a controller, filled in one   *
+ *              call and read by scripts as fields.    *
+ *******************************************************/
+
+#ifndef _SNAPSHOT_H
+#define _SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "API.h"
+#include "Mapping.h"
+
+/// State snapshot
+namespace AGSJoySnapshot {
+
+//------------------------------------------------------------------------------
+
+/// Script visible state (JoystickState in the script header)
+struct JoystickState
+{
+	// Exposed: <<<DO NOT CHANGE THE ORDER!!!>>>
+	// Read by scripts as readonly int fields, so these must stay 32 bits wide.
+	int32_t id;
+	int32_t x, y, z, u, v, w;
+	int32_t pov;
+	uint32_t buttons;
+	uint32_t pad_buttons;
+	int32_t pad_axis[AGSJoyMap::PAD_AXES];
+	int32_t mapped;
+	int32_t input_age;
+};
+
+#define STATE_FIELDS 18
+#define STATE_SIZE   (STATE_FIELDS * 4)
+
+static_assert(offsetof(JoystickState, pad_axis) == 40, "JoystickState: exposed layout changed");
+static_assert(sizeof (JoystickState) == STATE_SIZE, "JoystickState: exposed layout changed");
+
+AGS_DEFINE_CLASS(JoystickState)
+
+//------------------------------------------------------------------------------
+
+/// Returns a new snapshot, registered with the engine
+JoystickState *Create();
+
+//------------------------------------------------------------------------------
+
+} /* namespace AGSJoySnapshot */
+
+#endif /* _SNAPSHOT_H */
+
+//..............................................................................
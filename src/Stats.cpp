@@ -0,0 +1,123 @@
+/**************************************************************
+ * Plugin statistics -- See header file for more information. *
+ *************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "API.h"
+#include "Clock.h"
+#include "Stats.h"
+#include "Profile.h"
+
+//------------------------------------------------------------------------------
+
+namespace AGSJoyStats {
+
+Histogram latency;
+Histogram update;
+
+Counter polls;
+Counter events;
+Counter queued;
+Counter dropped;
+Counter coalesced;
+Counter open;
+Counter hotplug;
+Counter skipped;
+
+//------------------------------------------------------------------------------
+
+uint64_t Histogram::percentile(int p) const
+{
+	if (!count)
+		return 0;
+	
+	uint64_t rank = ((uint64_t) count * p + 99) / 100;
+	uint64_t seen = 0;
+	for (int i = 0; i < BUCKETS; ++i)
+	{
+		seen += bucket[i];
+		if (seen >= rank)
+		{
+			uint64_t bound = i ? ((uint64_t) 1 << i) - 1 : 0;
+			return (bound < max) ? bound : max;
+		}
+	}
+	return max;
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - 
+
+int Histogram::format(char *buffer, size_t size) const
+{
+	int len = snprintf(buffer, size, "n=%u p50=%llu p99=%llu max=%llu",
+		count, (unsigned long long) percentile(50),
+		(unsigned long long) percentile(99), (unsigned long long) max);
+	
+	for (int i = 0; i < BUCKETS && len >= 0 && (size_t) len < size; ++i)
+		if (bucket[i])
+			len += snprintf(buffer + len, size - len, " <%llu:%u",
+				(unsigned long long) ((uint64_t) 1 << i), bucket[i]);
+	
+	return len;
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - 
+
+void Histogram::clear()
+{
+	memset(this, 0, sizeof (*this));
+}
+
+//------------------------------------------------------------------------------
+
+const char *Report(int what)
+{
+	static char buffer[1024];
+	*buffer = 0;
+	
+	switch (what)
+	{
+		case JOY_DEBUG_LATENCY:
+			strcpy(buffer, "latency(us) ");
+			latency.format(buffer + strlen(buffer), sizeof (buffer) - strlen(buffer));
+			break;
+		
+		case JOY_DEBUG_COUNTERS:
+		{
+			// Poll rate since the previous query
+			static uint64_t last = 0;
+			static uint32_t lastpolls = 0;
+			uint64_t now = AGSJoyClock::Now();
+			uint32_t count = polls.get();
+			double rate = (last && now > last)
+				? (count - lastpolls) * 1000000.0 / (now - last) : 0.0;
+			last = now;
+			lastpolls = count;
+			
+			snprintf(buffer, sizeof (buffer), "polls/s=%.1f polls=%u events=%u "
+				"queued=%u dropped=%u coalesced=%u update(us) p50=%llu p99=%llu "
+				"open=%u hotplug=%u skipped=%u", rate, count, events.get(), queued.get(),
+				dropped.get(), coalesced.get(),
+				(unsigned long long) update.percentile(50),
+				(unsigned long long) update.percentile(99),
+				open.get(), hotplug.get(), skipped.get());
+			break;
+		}
+		
+		case JOY_DEBUG_PROFILE:
+			return AGSJoyProfile::Report();
+		
+		default:
+			break;
+	}
+	
+	return buffer;
+}
+
+//------------------------------------------------------------------------------
+
+} /* namespace AGSJoyStats */
+
+//..............................................................................
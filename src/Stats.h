@@ -0,0 +1,89 @@
+/*******************************************************
+ * Plugin statistics -- header file                    *
+ *                                                     *
+ * Author: agent                                       *
+ *                                                     *
+ * Date: 13:40 19-10-2026                              *
+ *                                                     *
+ * Description: Histograms and counters that can be    *
+ *              queried through hidden debug calls.    *
+ *******************************************************/
+
+#ifndef _STATS_H
+#define _STATS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <atomic>
+
+/// Plugin statistics
+namespace AGSJoyStats {
+
+//------------------------------------------------------------------------------
+
+/// Log-scale histogram: bucket i counts values in [2^(i-1), 2^i), bucket 0
+/// counts zeros. Values are microseconds unless noted otherwise.
+/// Note: this is zero initialized as a global, there is no constructor.
+struct Histogram
+{
+	enum { BUCKETS = 32 };
+	
+	uint32_t bucket[BUCKETS];
+	uint32_t count;
+	uint64_t max;
+	
+	inline void add(uint64_t value)
+	{
+		int i = 0;
+		for (uint64_t v = value; v && i < BUCKETS - 1; v >>= 1)
+			++i;
+		bucket[i]++;
+		count++;
+		if (value > max)
+			max = value;
+	}
+	
+	uint64_t percentile(int p) const; ///< Upper bound of the p-th percentile
+	int format(char *buffer, size_t size) const; ///< Readable summary
+	void clear();
+};
+
+#define JOY_CACHE_LINE 64
+
+/// Event counter; each one occupies its own cache line so counters written
+/// by different threads (or often) never share a line.
+struct alignas(JOY_CACHE_LINE) Counter
+{
+	std::atomic<uint32_t> value;
+	
+	inline void add(uint32_t n = 1) { value.fetch_add(n, std::memory_order_relaxed); }
+	inline void sub(uint32_t n = 1) { value.fetch_sub(n, std::memory_order_relaxed); }
+	inline uint32_t get() const { return value.load(std::memory_order_relaxed); }
+};
+
+static_assert(sizeof (Counter) == JOY_CACHE_LINE, "Counter: must fill a cache line");
+
+//------------------------------------------------------------------------------
+
+extern Histogram latency; ///< Input event to script dispatch
+extern Histogram update;  ///< Time spent in Update()
+
+extern Counter polls;     ///< Update() calls
+extern Counter events;    ///< Raw events read from devices
+extern Counter queued;    ///< Script events queued
+extern Counter dropped;   ///< Events lost to device buffer overruns
+extern Counter coalesced; ///< Events overwritten before they were sampled
+extern Counter open;      ///< Open joystick instances
+extern Counter hotplug;   ///< Devices plugged in or unplugged
+extern Counter skipped;   ///< Device polls skipped while idle
+
+const char *Report(int what); ///< Formatted report (see JOY_DEBUG_*)
+
+//------------------------------------------------------------------------------
+
+} /* namespace AGSJoyStats */
+
+#endif /* _STATS_H */
+
+//..............................................................................
@@ -0,0 +1,78 @@
+/**********************************************************
+ * Binary trace -- See header file for more information. *
+ **********************************************************/
+
+#include <stdio.h>
+
+#include "API.h"
+#include "Trace.h"
+
+//------------------------------------------------------------------------------
+
+namespace AGSJoyTrace {
+
+Record ring[TRACE_SIZE];
+std::atomic<uint32_t> head(0);
+
+uint32_t tail = 0; // First record not yet dumped
+
+// Indexed by Event; arguments are passed as long long
+static const char *formats[TRACE_EVENTS] =
+{
+	"Created: #%lld %llx",
+	"Created from savefile: #%lld %llx",
+	"Deleted: #%lld %llx",
+	"Could not update joy: #%lld %llx",
+	"Device unplugged: #%lld",
+	"Device buffer overrun, resynced: #%lld",
+	"Update: %lld open",
+	"Updated in %lld us",
+};
+
+//------------------------------------------------------------------------------
+
+void Dump()
+{
+	using namespace AGSJoyAPI;
+	
+	uint32_t end = head.load(std::memory_order_acquire);
+	if (end - tail > TRACE_SIZE) // Older records have been overwritten
+		tail = end - TRACE_SIZE;
+	
+	char line[256];
+	for (; tail != end; ++tail)
+	{
+		// Copy first and check the sequence again afterwards: a writer that
+		// wrapped around while we were copying leaves a torn record.
+		const Record &slot = ring[tail & (TRACE_SIZE - 1)];
+		if (slot.seq.load(std::memory_order_acquire) != tail + 1)
+			continue; // Still being written or already reused
+		
+		struct { uint64_t time; uint32_t event; int64_t arg[3]; } r;
+		r.time = slot.time;
+		r.event = slot.event;
+		r.arg[0] = slot.arg[0];
+		r.arg[1] = slot.arg[1];
+		r.arg[2] = slot.arg[2];
+		
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (slot.seq.load(std::memory_order_relaxed) != tail + 1)
+			continue; // Overwritten while copying
+		
+		int len = snprintf(line, sizeof (line), "[Joystick %llu.%06llu] ",
+			(unsigned long long) (r.time / 1000000),
+			(unsigned long long) (r.time % 1000000));
+		if (r.event < TRACE_EVENTS)
+			snprintf(line + len, sizeof (line) - len, formats[r.event],
+				(long long) r.arg[0], (long long) r.arg[1], (long long) r.arg[2]);
+		
+		if (engine)
+			engine->PrintDebugConsole(line);
+	}
+}
+
+//------------------------------------------------------------------------------
+
+} /* namespace AGSJoyTrace */
+
+//..............................................................................
@@ -0,0 +1,88 @@
+/*******************************************************
+ * Binary trace -- header file                         *
+ *                                                     *
+ * Author: agent                                       *
+ *                                                     *
+ * Date: 15:10 19-10-2026                              *
+ *                                                     *
+ * Description: Lock-free ring of binary trace records *
+ *              that are only formatted when dumped.   *
+ *******************************************************/
+
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include <stdint.h>
+
+#include <atomic>
+
+#include "Clock.h"
+
+#if defined(DEBUG) || defined(JOY_TRACE)
+#	define JOY_TRACING
+#endif
+
+/// Binary trace
+namespace AGSJoyTrace {
+
+//------------------------------------------------------------------------------
+
+/// Trace events; the format strings are in Trace.cpp (keep them in sync!)
+enum Event
+{
+	TRACE_CREATED,      // id, address
+	TRACE_RESTORED,     // id, address
+	TRACE_DELETED,      // id, address
+	TRACE_READ_FAILED,  // id, address
+	TRACE_UNPLUGGED,    // id
+	TRACE_DROPPED,      // id
+	TRACE_UPDATE,       // open joysticks
+	TRACE_UPDATED,      // microseconds spent
+	TRACE_EVENTS
+};
+
+#define TRACE_SIZE 4096 // Records kept, must be a power of two
+
+struct Record
+{
+	uint64_t time;
+	std::atomic<uint32_t> seq; // Index + 1 once the record is complete
+	uint32_t event;
+	int64_t arg[3];
+};
+
+extern Record ring[TRACE_SIZE];
+extern std::atomic<uint32_t> head;
+
+//------------------------------------------------------------------------------
+
+/// Appends a record; safe to call from any thread
+inline void Log(uint32_t event, int64_t a = 0, int64_t b = 0, int64_t c = 0)
+{
+	uint32_t index = head.fetch_add(1, std::memory_order_relaxed);
+	Record &r = ring[index & (TRACE_SIZE - 1)];
+	r.seq.store(0, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release); // Invalidate before writing
+	r.time = AGSJoyClock::Now();
+	r.event = event;
+	r.arg[0] = a;
+	r.arg[1] = b;
+	r.arg[2] = c;
+	r.seq.store(index + 1, std::memory_order_release);
+}
+
+void Dump(); ///< Formats records logged since the last dump to the debug console
+
+//------------------------------------------------------------------------------
+
+} /* namespace AGSJoyTrace */
+
+#ifdef JOY_TRACING
+#	define TRACE(...) AGSJoyTrace::Log(AGSJoyTrace::__VA_ARGS__)
+#else
+#	define TRACE(...) ((void) 0)
+#endif
+
+#endif /* _TRACE_H */
+
+//..............................................................................
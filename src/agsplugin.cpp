@@ -18,6 +18,12 @@
 //#include "agsplugin.h" // Included by API.h
 #include "API.h"
 #include "Joystick.h"
+#include "Action.h"
+#include "Clock.h"
+#include "Mapping.h"
+#include "Stats.h"
+#include "Trace.h"
+#include "Probes.h"
 
 DLLEXPORT int AGS_PluginV2() { return 1; }
 
@@ -105,6 +111,102 @@ void AGS_EditorLoadGame(char *buffer, int bufsize) {}
 bool fallbackstate = false; // TODO: Add DirectX 8 detection here
 #endif
 
+int sampling = JOY_SAMPLE_PRERENDER; // When controllers are sampled
+int active = 0; // Open joystick instances; event hooks are requested while any
+
+//------------------------------------------------------------------------------
+
+void SetHooks(int mode)
+{
+	using namespace AGSJoyAPI;
+	
+	// Without open joysticks there is nothing to sample
+	if (!active)
+		mode = 0;
+	
+	// The background reader keeps the device state current; copying it into
+	// the script visible fields happens at both moments.
+	if (mode == JOY_SAMPLE_LATEST)
+		mode = JOY_SAMPLE_BOTH;
+	
+	if (mode & JOY_SAMPLE_PRERENDER)
+		engine->RequestEventHook(AGSE_PRERENDER);
+	else
+		engine->UnrequestEventHook(AGSE_PRERENDER);
+	
+	if (mode & JOY_SAMPLE_FINALDRAW)
+		engine->RequestEventHook(AGSE_FINALSCREENDRAW);
+	else
+		engine->UnrequestEventHook(AGSE_FINALSCREENDRAW);
+}
+
+//------------------------------------------------------------------------------
+
+long JoystickSetSampling(long mode)
+{
+	if (mode < JOY_SAMPLE_PRERENDER || mode > JOY_SAMPLE_LATEST)
+		return 0;
+	
+	bool background = (mode == JOY_SAMPLE_LATEST);
+	if (background != (sampling == JOY_SAMPLE_LATEST))
+	{
+		bool result = false;
+		FALLBACK(fallbackstate, result = Background(background));
+		if (!result && background)
+			return 0;
+	}
+	
+	sampling = mode;
+	SetHooks(sampling);
+	return 1;
+}
+
+//------------------------------------------------------------------------------
+
+void JoystickActive(bool open)
+{
+	// The engine only calls the plugin every frame while a joystick is open
+	// (events need one too); the first one opening and the last one closing
+	// switch the hooks.
+	active += open ? 1 : -1;
+	if (active == (open ? 1 : 0))
+		SetHooks(sampling);
+	
+	// Nothing evaluates the actions anymore, so none stays down
+	if (!active)
+		AGSJoyAction::Reset();
+}
+
+//------------------------------------------------------------------------------
+
+long JoystickAddMappings(const char *mappings)
+{
+	return AGSJoyMap::Add(mappings);
+}
+
+//------------------------------------------------------------------------------
+
+long JoystickRoomActionSet(long room, long set)
+{
+	using namespace AGSJoyAPI;
+	
+	if (!AGSJoyAction::Room(room, set))
+		return 0;
+	
+	// The room events are only needed while some room switches sets
+	if (AGSJoyAction::Rooms())
+	{
+		engine->RequestEventHook(AGSE_ENTERROOM);
+		engine->RequestEventHook(AGSE_LEAVEROOM);
+	}
+	else
+	{
+		engine->UnrequestEventHook(AGSE_ENTERROOM);
+		engine->UnrequestEventHook(AGSE_LEAVEROOM);
+	}
+	return 1;
+}
+
 //------------------------------------------------------------------------------
 
 void AGS_EngineStartup(IAGSEngine *lpEngine)
@@ -117,14 +219,15 @@ void AGS_EngineStartup(IAGSEngine *lpEngine)
 	if (engine->version < MIN_ENGINE_VERSION)
 		engine->AbortGame("Plugin needs engine version " STRINGIFY(MIN_ENGINE_VERSION) " or newer.");
 	
-	// Initialize plugin
+	// Initialize plugin (mappings first, joysticks pick theirs when opened)
+	AGSJoyMap::Startup();
 	FALLBACK(fallbackstate, Initialize());
+	active = 0;
 	
 	// Script bindings
 	FALLBACK(fallbackstate, JOYSTICK_ENTRY);
 	
-	// Request event hooks
-	engine->RequestEventHook(AGSE_PRERENDER);
+	// Event hooks are requested when the first joystick is opened
 }
 
 //------------------------------------------------------------------------------
@@ -133,6 +236,12 @@ void AGS_EngineShutdown()
 {
 	// Terminate plugin
 	FALLBACK(fallbackstate, Terminate());
+	AGSJoyMap::Clear();
+	AGSJoyAction::Clear();
+	
+	#ifdef JOY_TRACING
+	AGSJoyTrace::Dump();
+	#endif
 }
 
 //------------------------------------------------------------------------------
@@ -141,13 +250,33 @@ int AGS_EngineOnEvent(int event, int data)
 {
 	switch (event)
 	{
-		// Note: Is this really the best moment to update? Maybe we should do it
-		// AFTER drawing so it would be closer to the next game logic update.
-		// Try AGSE_FINALSCREENDRAW instead.
+		// Which of these are hooked depends on the sampling mode: prerender
+		// is before drawing, the final screen draw is closer to the next game
+		// logic update.
 		case AGSE_PRERENDER:
+		case AGSE_FINALSCREENDRAW:
+		{
+			TRACE(TRACE_UPDATE, AGSJoyStats::open.get());
+			PROBE1(update__entry, AGSJoyStats::open.get());
+			uint64_t start = AGSJoyClock::Now();
 			FALLBACK(fallbackstate, Update());
+			uint64_t time = AGSJoyClock::Now() - start;
+			PROBE1(update__exit, time);
+			AGSJoyStats::update.add(time);
+			AGSJoyStats::polls.add();
+			TRACE(TRACE_UPDATED, time);
 			break;
-
+		}
+		
+		// Rooms with an action set of their own (data is the room number)
+		case AGSE_ENTERROOM:
+			AGSJoyAction::Enter(data);
+			break;
+		
+		case AGSE_LEAVEROOM:
+			AGSJoyAction::Leave();
+			break;
+		
 		default:
 			break;
 	}
@@ -0,0 +1,488 @@
+/*******************************************************
+ * Joystick benchmark                                  *
+ *                                                     *
+ * Author: agent                                       *
+ *                                                     *
+ * Date: 16:45 19-10-2026                              *
+ *                                                     *
+ * Description: Measures the plugin's hot paths on     *
+ *              stand-in devices.                      *
+ *******************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <linux/input.h>
+
+#include <vector>
+
+#ifdef JOY_SDL
+#include <SDL.h>
+#endif
+
+#include "engine.h"
+#include "Clock.h"
+#include "Ring.h"
+#include "Cache.h"
+#include "Mapping.h"
+
+using Engine::Value;
+
+//------------------------------------------------------------------------------
+// Startup: the engine waits for AGS_EngineStartup, scripts only for the
+// device list (when they ask for it). A cold start has no device cache, a
+// warm start finds the one the cold start wrote.
+
+void Startup(const char *name)
+{
+	uint64_t start = AGSJoyClock::Now();
+	Engine::Initialize();
+	uint64_t started = AGSJoyClock::Now();
+	long count = Engine::Call("JoystickCount", 0, NULL);
+	uint64_t scanned = AGSJoyClock::Now();
+	Engine::Terminate();
+	
+	printf("  %-9s %ld joysticks, engine startup %6llu us, first JoystickCount %6llu us\n",
+		name, count, (unsigned long long) (started - start),
+		(unsigned long long) (scanned - start));
+}
+
+//------------------------------------------------------------------------------
+// Device cache: loading it and confirming every entry, as a warm start does.
+
+void Cache(const char *file, int count, int rounds)
+{
+	AGSJoyCache::Store store;
+	store.load(file);
+	for (int i = 0; i < count; ++i)
+	{
+		char key[32];
+		snprintf(key, sizeof (key), "/dev/input/event%d", i);
+		store.put(key, std::string(28, (char) i), std::string(200, 'x'));
+	}
+	store.save();
+	
+	uint64_t start = AGSJoyClock::Now();
+	int hits = 0;
+	for (int r = 0; r < rounds; ++r)
+	{
+		store.load(file);
+		for (int i = 0; i < count; ++i)
+		{
+			char key[32];
+			snprintf(key, sizeof (key), "/dev/input/event%d", i);
+			hits += store.find(key, std::string(28, (char) i)) != NULL;
+		}
+	}
+	uint64_t time = AGSJoyClock::Now() - start;
+	
+	printf("  %-9s %d entries, %d hits, %7.2f us per load and lookup\n", "cache",
+		count, hits / rounds, (double) time / rounds);
+}
+
+//------------------------------------------------------------------------------
+// Mappings: parsing a gamecontrollerdb.txt of that many lines against mapping
+// the compiled database, both followed by lookups for a few connected pads.
+
+void Mappings(const char *text, const char *blob, int count, int rounds)
+{
+	std::string db;
+	std::vector<AGSJoyMap::Mapping> maps;
+	for (int i = 0; i < count; ++i)
+	{
+		char line[512];
+		snprintf(line, sizeof (line), "03000000%02x%02x0000%02x%02x000001000000,Pad %d,"
+			"a:b0,b:b1,back:b6,dpdown:h0.4,dpleft:h0.8,dpright:h0.2,dpup:h0.1,guide:b8,"
+			"leftshoulder:b4,leftstick:b9,lefttrigger:a2,leftx:a0,lefty:a1,rightshoulder:b5,"
+			"rightstick:b10,righttrigger:a5,rightx:a3,righty:a4,start:b7,x:b2,y:b3,platform:%s,\n",
+			i & 255, (i >> 8) & 255, (i * 7) & 255, 0x10 | ((i >> 16) & 15), i, AGSJoyMap::Platform());
+		db += line;
+		maps.push_back(AGSJoyMap::Mapping());
+		AGSJoyMap::Parse(line, maps.back(), AGSJoyMap::Platform());
+	}
+	
+	std::string compiled = AGSJoyMap::Compile(maps, AGSJoyMap::Platform());
+	FILE *fp = fopen(text, "wb");
+	if (fp)
+		fwrite(db.data(), 1, db.size(), fp), fclose(fp);
+	fp = fopen(blob, "wb");
+	if (fp)
+		fwrite(compiled.data(), 1, compiled.size(), fp), fclose(fp);
+	
+	const char *name[] = { "text", "compiled" };
+	const char *file[] = { text, blob };
+	for (int f = 0; f < 2; ++f)
+	{
+		uint64_t start = AGSJoyClock::Now();
+		int hits = 0;
+		for (int r = 0; r < rounds; ++r)
+		{
+			AGSJoyMap::Clear();
+			AGSJoyMap::Load(file[f]);
+			for (int i = 0; i < 4; ++i)
+				hits += AGSJoyMap::Find(maps[(i * 97) % count].guid) != NULL;
+		}
+		uint64_t time = AGSJoyClock::Now() - start;
+		AGSJoyMap::Clear();
+		
+		printf("  %-9s %d mappings, %d of 4 found, %9.2f us per load and lookup\n", name[f],
+			count, hits / rounds, (double) time / rounds);
+	}
+	
+	printf("  %-9s %lu bytes text, %lu bytes compiled\n", "size",
+		(unsigned long) db.size(), (unsigned long) compiled.size());
+}
+
+//------------------------------------------------------------------------------
+// Script reads: the complete state of a controller every frame, through the
+// calls a script has for it (six axes, 32 buttons, the age) against a single
+// GetState refilling the same snapshot. Without a device the fake one is read.
+
+void Script(int frames)
+{
+	Engine::Initialize();
+	Value id[] = {Engine::Call("JoystickCount", 0, NULL) ? 0 : -1};
+	Value joy = Engine::Call("Joystick::Open", 1, id);
+	
+	const char *name[] = { "fields", "snapshot" };
+	for (int mode = 0; mode < 2; ++mode)
+	{
+		Value state = 0;
+		long calls = 0;
+		uint64_t start = AGSJoyClock::Now();
+		for (int f = 0; f < frames; ++f)
+		{
+			if (mode)
+			{
+				Value args[] = {joy, state};
+				state = Engine::Call("Joystick::GetState", 2, args);
+				calls++;
+				continue;
+			}
+			
+			for (int i = 0; i < 6; ++i)
+			{
+				Value args[] = {joy, i};
+				Engine::Call("Joystick::GetAxis", 2, args);
+			}
+			for (int i = 0; i < 32; ++i)
+			{
+				Value args[] = {joy, i};
+				Engine::Call("Joystick::IsButtonDown", 2, args);
+			}
+			Value args[] = {joy};
+			Engine::Call("Joystick::GetInputAge", 1, args);
+			calls += 6 + 32 + 1;
+		}
+		uint64_t time = AGSJoyClock::Now() - start;
+		
+		printf("  %-9s %6.2f calls/frame %7.3f us/frame\n", name[mode],
+			(double) calls / frames, (double) time / frames);
+	}
+	
+	Value args[] = {joy};
+	Engine::Call("Joystick::Close", 1, args);
+	Engine::Terminate();
+}
+
+//------------------------------------------------------------------------------
+// Device reads: per frame a few of the devices receive an event and every
+// device is read the way the plugin would. Pipes stand in for event nodes,
+// the writes are not counted.
+
+struct Devices
+{
+	std::vector<int> in, out;
+	
+	Devices(int count, bool blocking)
+	{
+		for (int i = 0; i < count; ++i)
+		{
+			int fd[2];
+			if (pipe2(fd, blocking ? O_CLOEXEC : O_CLOEXEC | O_NONBLOCK))
+				exit(EXIT_FAILURE);
+			in.push_back(fd[0]);
+			out.push_back(fd[1]);
+		}
+	}
+	
+	~Devices()
+	{
+		for (size_t i = 0; i < in.size(); ++i)
+			close(in[i]), close(out[i]);
+	}
+	
+	void input(int frame, int active)
+	{
+		struct input_event ev;
+		memset(&ev, 0, sizeof (ev));
+		ev.type = EV_KEY;
+		ev.code = BTN_TRIGGER;
+		ev.value = frame & 1;
+		for (int i = 0; i < active; ++i)
+			if (write(out[(frame + i) % out.size()], &ev, sizeof (ev)) < 0)
+				exit(EXIT_FAILURE);
+	}
+};
+
+struct Result
+{
+	uint64_t syscalls;
+	uint64_t events;
+	uint64_t time; // Microseconds
+};
+
+//------------------------------------------------------------------------------
+
+Result ReadDirect(int count, int active, int frames)
+{
+	Devices dev(count, false);
+	Result r = { 0, 0, 0 };
+	struct input_event ev[64];
+	
+	for (int f = 0; f < frames; ++f)
+	{
+		dev.input(f, active);
+		uint64_t start = AGSJoyClock::Now();
+		for (int i = 0; i < count; ++i)
+		{
+			ssize_t size;
+			do
+			{
+				r.syscalls++;
+				size = read(dev.in[i], ev, sizeof (ev));
+				if (size > 0)
+					r.events += size / sizeof (*ev);
+			}
+			while (size == (ssize_t) sizeof (ev));
+		}
+		r.time += AGSJoyClock::Now() - start;
+	}
+	
+	return r;
+}
+
+//------------------------------------------------------------------------------
+
+Result ReadEpoll(int count, int active, int frames)
+{
+	Devices dev(count, false);
+	Result r = { 0, 0, 0 };
+	struct input_event ev[64];
+	
+	int ep = epoll_create1(EPOLL_CLOEXEC);
+	for (int i = 0; i < count; ++i)
+	{
+		struct epoll_event e;
+		e.events = EPOLLIN;
+		e.data.u32 = i;
+		epoll_ctl(ep, EPOLL_CTL_ADD, dev.in[i], &e);
+	}
+	
+	std::vector<struct epoll_event> ready(count);
+	for (int f = 0; f < frames; ++f)
+	{
+		dev.input(f, active);
+		uint64_t start = AGSJoyClock::Now();
+		r.syscalls++;
+		int n = epoll_wait(ep, &ready[0], count, 0);
+		for (int i = 0; i < n; ++i)
+		{
+			r.syscalls++;
+			ssize_t size = read(dev.in[ready[i].data.u32], ev, sizeof (ev));
+			if (size > 0)
+				r.events += size / sizeof (*ev);
+		}
+		r.time += AGSJoyClock::Now() - start;
+	}
+	
+	close(ep);
+	return r;
+}
+
+//------------------------------------------------------------------------------
+
+Result ReadRing(int count, int active, int frames)
+{
+	Devices dev(count, true);
+	Result r = { 0, 0, 0 };
+	
+	AGSJoyRing::Ring ring;
+	if (!ring.open(count))
+	{
+		r.syscalls = (uint64_t) -1;
+		return r;
+	}
+	
+	std::vector<struct input_event> buffer(count * 64);
+	std::vector<AGSJoyRing::Completion> done(count);
+	for (int i = 0; i < count; ++i)
+		ring.read(dev.in[i], &buffer[i * 64], 64 * sizeof (struct input_event),
+			(void *) (intptr_t) (i + 1)); // NULL is a cancel
+	ring.submit();
+	ring.enters = 0;
+	
+	for (int f = 0; f < frames; ++f)
+	{
+		dev.input(f, active);
+		uint64_t start = AGSJoyClock::Now();
+		int n = ring.reap(&done[0], count);
+		for (int i = 0; i < n; ++i)
+		{
+			int index = (int) (intptr_t) done[i].data - 1;
+			if (done[i].result > 0)
+				r.events += done[i].result / sizeof (struct input_event);
+			ring.read(dev.in[index], &buffer[index * 64],
+				64 * sizeof (struct input_event), done[i].data);
+		}
+		ring.submit();
+		r.time += AGSJoyClock::Now() - start;
+	}
+	
+	r.syscalls = ring.enters;
+	
+	// The buffer must outlive the reads in flight
+	for (int i = 0; i < count; ++i)
+		ring.cancel((void *) (intptr_t) (i + 1));
+	for (int flight = count; flight > 0;)
+	{
+		if (ring.submit(1) < 0)
+			break;
+		int n = ring.reap(&done[0], count);
+		for (int i = 0; i < n; ++i)
+			if (done[i].data)
+				flight--;
+	}
+	
+	return r;
+}
+
+//------------------------------------------------------------------------------
+// SDL: virtual joysticks stand in for the devices, SDL reads its own nodes. The
+// syscalls column counts calls into SDL here (a pump and the event batches).
+
+#ifdef JOY_SDL
+Result ReadSDL(int count, int active, int frames)
+{
+	Result r = { 0, 0, 0 };
+	if (SDL_InitSubSystem(SDL_INIT_JOYSTICK))
+	{
+		r.syscalls = (uint64_t) -1;
+		return r;
+	}
+	SDL_JoystickEventState(SDL_ENABLE);
+	
+	std::vector<SDL_Joystick *> dev;
+	for (int i = 0; i < count; ++i)
+	{
+		int index = SDL_JoystickAttachVirtual(SDL_JOYSTICK_TYPE_GAMECONTROLLER, 6, 16, 1);
+		if (SDL_Joystick *joy = SDL_JoystickOpen(index))
+			dev.push_back(joy);
+	}
+	SDL_PumpEvents();
+	SDL_FlushEvents(SDL_FIRSTEVENT, SDL_LASTEVENT);
+	
+	SDL_Event ev[64];
+	for (int f = 0; f < frames && !dev.empty(); ++f)
+	{
+		for (int i = 0; i < active; ++i)
+			SDL_JoystickSetVirtualButton(dev[(f + i) % dev.size()], 0, f & 1);
+		
+		uint64_t start = AGSJoyClock::Now();
+		r.syscalls++;
+		SDL_PumpEvents();
+		int n;
+		do
+		{
+			r.syscalls++;
+			n = SDL_PeepEvents(ev, 64, SDL_GETEVENT, SDL_JOYAXISMOTION, SDL_JOYDEVICEREMOVED);
+			if (n > 0)
+				r.events += n;
+		}
+		while (n == 64);
+		r.time += AGSJoyClock::Now() - start;
+	}
+	
+	for (size_t i = 0; i < dev.size(); ++i)
+	{
+		SDL_JoystickID instance = SDL_JoystickInstanceID(dev[i]);
+		SDL_JoystickClose(dev[i]);
+		for (int index = SDL_NumJoysticks() - 1; index >= 0; --index)
+			if (SDL_JoystickGetDeviceInstanceID(index) == instance)
+				SDL_JoystickDetachVirtual(index);
+	}
+	SDL_QuitSubSystem(SDL_INIT_JOYSTICK);
+	return r;
+}
+#endif
+
+//------------------------------------------------------------------------------
+
+void Print(const char *name, const Result &r, int frames)
+{
+	if (r.syscalls == (uint64_t) -1)
+	{
+		printf("  %-9s unavailable\n", name);
+		return;
+	}
+	
+	printf("  %-9s %8llu syscalls %6.2f/frame %8llu events %7.2f us/frame\n", name,
+		(unsigned long long) r.syscalls, (double) r.syscalls / frames,
+		(unsigned long long) r.events, (double) r.time / frames);
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char *argv[])
+{
+	int count = (argc > 1) ? atoi(argv[1]) : 16;
+	int active = (argc > 2) ? atoi(argv[2]) : 2;
+	int frames = (argc > 3) ? atoi(argv[3]) : 10000;
+	if (count < 1 || active < 0 || active > count || frames < 1)
+	{
+		fprintf(stderr, "Usage: %s [devices] [active] [frames]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	
+	// Keeps the player's own cache out of it
+	char file[] = "/tmp/joybench.XXXXXX";
+	int fd = mkstemp(file);
+	if (fd < 0)
+		return EXIT_FAILURE;
+	close(fd);
+	setenv(CACHE_ENV, file, 1);
+	setenv(MAPPING_ENV, "", 1);
+	
+	printf("Startup:\n");
+	remove(file);
+	Startup("cold");
+	Startup("warm");
+	remove(file);
+	Cache(file, count, 1000);
+	remove(file);
+	
+	std::string text = std::string(file) + ".txt", blob = std::string(file) + ".bin";
+	printf("Mappings:\n");
+	Mappings(text.c_str(), blob.c_str(), 2000, 20);
+	remove(text.c_str());
+	remove(blob.c_str());
+	
+	printf("Script: %d frames\n", frames);
+	Script(frames);
+	
+	printf("Reads: %d devices, %d active per frame, %d frames\n", count, active, frames);
+	Print("read", ReadDirect(count, active, frames), frames);
+	Print("epoll", ReadEpoll(count, active, frames), frames);
+	Print("io_uring", ReadRing(count, active, frames), frames);
+	#ifdef JOY_SDL
+	Print("sdl", ReadSDL(count, active, frames), frames);
+	#endif
+	
+	return EXIT_SUCCESS;
+}
+
+//..............................................................................
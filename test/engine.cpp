@@ -61,6 +61,7 @@ struct Function
 std::map<std::string,Function> functions;
 
 std::set<long> events;
+long misses = 0;
 
 struct Object
 {
@@ -131,8 +132,30 @@ void Initialize()
 
 //- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - 
 
+bool Working()
+{
+	// The plugin has work while a joystick object is open (its ID is valid)
+	for (size_t i = 0; i < objects.size(); ++i)
+		if (objects[i].addr && !strcmp(objects[i].manager->GetType(), "Joystick")
+		&& *(const int *) objects[i].addr != -1)
+			return true;
+	return false;
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - 
+
 bool Trigger(long event, long data)
 {
+	// Either frame event will do, which one depends on the sampling mode
+	bool frame = (event == AGSE_PRERENDER || event == AGSE_FINALSCREENDRAW);
+	bool hooked = events.count(AGSE_PRERENDER) || events.count(AGSE_FINALSCREENDRAW);
+	if (frame && hooked != Working())
+	{
+		printf("[check] frame %s\n", hooked ? "hooked without open joysticks"
+			: "not hooked with open joysticks");
+		misses++;
+	}
+	
 	if (!events.count(event))
 		return false;
 	return !!AGS_EngineOnEvent(event, data);
@@ -140,6 +163,20 @@ bool Trigger(long event, long data)
 
 //- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - 
 
+long Misses()
+{
+	return misses;
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - 
+
+bool Hooked(long event)
+{
+	return !!events.count(event);
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - 
+
 void Terminate()
 {
 	Object::clear();
@@ -41,6 +41,8 @@ namespace Engine {
 
 void Initialize();
 bool Trigger(long event, long data);
+bool Hooked(long event);
+long Misses(); // Frames the plugin was hooked without work, or the other way
 void Terminate();
 
 bool Save(const char *filename);
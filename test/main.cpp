@@ -11,6 +11,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdarg.h>
 
 #include "engine.h"
 
@@ -21,6 +22,23 @@ using Engine::Handle;
 
 struct Point { int x, y; };
 
+int failures = 0;
+
+/// Reports an expectation that did not hold; any of them fails the test
+void Check(bool ok, const char *fmt, ...)
+{
+	if (ok)
+		return;
+	
+	va_list args;
+	va_start(args, fmt);
+	printf("[check] ");
+	vprintf(fmt, args);
+	printf("\n");
+	va_end(args);
+	failures++;
+}
+
 int main(int argc, char *argv[])
 {
 	Engine::Initialize();
@@ -29,12 +47,102 @@ int main(int argc, char *argv[])
 	Value val = Engine::Call("JoystickName", 1, args);
 	printf("(%s)\n", (const char *) val);
 	
+	Value debug[] = {-2};
+	printf("%s\n", (const char *) Engine::Call("JoystickName", 1, debug));
+	long count = (long) Engine::Call("JoystickCount", 0, NULL);
+	printf("Joysticks: %ld\n", count);
+	
+	// The frame hooks follow the sampling mode while a joystick is open; the
+	// aggregate (JOY_ANY) opens without devices too. Background reading (4)
+	// may be unsupported, which leaves mode 3 (both hooks) in place.
+	Value any[] = {-3};
+	Value joy = Engine::Call("Joystick::Open", 1, any);
+	Value self[] = {joy};
+	for (int mode = 1; mode <= 4; ++mode)
+	{
+		Value arg[] = {mode};
+		bool ok = Engine::Call("JoystickSetSampling", 1, arg);
+		bool pre = Engine::Hooked(AGSE_PRERENDER);
+		bool fin = Engine::Hooked(AGSE_FINALSCREENDRAW);
+		Check(ok || mode == 4, "sampling %d: unsupported", mode);
+		Check(pre == (mode != 2) && fin == (mode != 1),
+			"sampling %d: prerender %d, final draw %d", mode, pre, fin);
+	}
+	Value reset[] = {1};
+	Engine::Call("JoystickSetSampling", 1, reset);
+	Check(Engine::Hooked(AGSE_PRERENDER) && !Engine::Hooked(AGSE_FINALSCREENDRAW),
+		"sampling reset: hooks not restored");
+	Engine::Call("Joystick::Close", 1, self);
+	Check(!Engine::Hooked(AGSE_PRERENDER) && !Engine::Hooked(AGSE_FINALSCREENDRAW),
+		"hooked with nothing open");
+	
+	// One for every platform, one broken (the xinput line is SDL's own)
+	Value mappings[] = {
+		"030000005e0400008e02000014010000,Xbox 360 Controller,a:b0,b:b1,x:b2,y:b3,leftx:a0,lefty:a1,\n"
+		"# comment\n"
+		"xinput,XInput Controller,a:b0,b:b1,\n"
+		"03000000de280000ff11000001000000,Steam Virtual Gamepad,a:b0,dpup:h0.1,lefttrigger:+a2,\n"};
+	long added = (long) Engine::Call("JoystickAddMappings", 1, mappings);
+	Check(added == 2, "mappings: %ld added", added);
+	
+	// Nothing is open, so a bound action is never down
+	Value name[] = {"Jump"};
+	Value action = Engine::Call("Joystick::Action", 1, name);
+	Value bind[] = {action, 0, 1, 0, 16384, 32767, 0};
+	long bound = (long) Engine::Call("Joystick::BindAction", 7, bind);
+	Value query[] = {action};
+	long down = (long) Engine::Call("Joystick::IsActionDown", 1, query);
+	Check((long) action >= 0 && bound && !down, "action %ld: bound %ld, down %ld",
+		(long) action, bound, down);
+	
+	// Room 2 has a set of its own, the room events are hooked while it does
+	Value menu[] = {"Menu"};
+	Value room[] = {2, Engine::Call("Joystick::ActionSet", 1, menu)};
+	Engine::Call("JoystickRoomActionSet", 2, room);
+	Engine::Trigger(AGSE_ENTERROOM, 2);
+	long entered = (long) Engine::Call("Joystick::GetActionSet", 0, NULL);
+	Engine::Trigger(AGSE_LEAVEROOM, 0);
+	long left = (long) Engine::Call("Joystick::GetActionSet", 0, NULL);
+	room[1] = -1;
+	Engine::Call("JoystickRoomActionSet", 2, room);
+	bool hooked = Engine::Hooked(AGSE_ENTERROOM);
+	Check(entered == 1 && left == 0 && !hooked, "action sets: room %ld, after %ld, hooked %d",
+		entered, left, hooked);
+	
+	for (int i = 0; i < 3; ++i)
+		Engine::Trigger(AGSE_PRERENDER, 0);
+	
+	Value latency[] = {-3};
+	printf("%s\n", (const char *) Engine::Call("JoystickName", 1, latency));
+	Value counters[] = {-4};
+	printf("%s\n", (const char *) Engine::Call("JoystickName", 1, counters));
+	Value profile[] = {-6};
+	printf("%s\n", (const char *) Engine::Call("JoystickName", 1, profile));
+	
+	// The aggregate is open without devices too, so the frames keep coming;
+	// it is unplugged while no device is
+	joy = Engine::Call("Joystick::Open", 1, any);
+	self[0] = joy;
+	Engine::Trigger(AGSE_PRERENDER, 0);
+	long open = (long) Engine::Call("Joystick::IsOpen", 1, any);
+	long valid = (long) Engine::Call("Joystick::Valid", 1, self);
+	long unplugged = (long) Engine::Call("Joystick::Unplugged", 1, self);
+	Check(open && valid && unplugged == !count, "any: open %ld, valid %ld, unplugged %ld",
+		open, valid, unplugged);
+	Engine::Call("Joystick::Close", 1, self);
+	Engine::Trigger(AGSE_PRERENDER, 0);
+	
 	Handle<Point> test = new Point();
 	if (!test.empty())
 		(*test)->x = 1337;
 	
+	// The plugin is only called every frame while a joystick is open
+	long misses = Engine::Misses();
+	Check(!misses, "hooks: %ld frames missed", misses);
+	
 	Engine::Terminate();
-	return EXIT_SUCCESS;
+	printf("Checks: %s\n", failures ? "FAILED" : "ok");
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
 }
 
 //..............................................................................
@@ -0,0 +1,117 @@
+/*******************************************************
+ * Controller mapping compiler                         *
+ *                                                     *
+ * Author: agent                                       *
+ *                                                     *
+ * Date: 21:05 19-10-2026                              *
+ *                                                     *
+ * Description: Compiles gamecontrollerdb.txt files    *
+ *              into the database the plugin maps.     *
+ *******************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Mapping.h"
+
+using namespace AGSJoyMap;
+
+//------------------------------------------------------------------------------
+
+bool Read(const char *file, std::string &text)
+{
+	FILE *fp = fopen(file, "rb");
+	if (!fp)
+		return false;
+	
+	char buffer[4096];
+	size_t size;
+	while ((size = fread(buffer, 1, sizeof (buffer), fp)) > 0)
+		text.append(buffer, size);
+	fclose(fp);
+	return true;
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char *argv[])
+{
+	const char *platform = Platform();
+	int arg = 1;
+	if (arg + 1 < argc && !strcmp(argv[arg], "-p"))
+		platform = argv[arg + 1], arg += 2;
+	
+	if (argc - arg < 2)
+	{
+		fprintf(stderr, "Usage: %s [-p platform] output input...\n"
+			"Compiles mappings for one platform (default %s) into %s format.\n",
+			argv[0], Platform(), MAPPING_BLOB);
+		return EXIT_FAILURE;
+	}
+	
+	// Later lines replace earlier ones for the same GUID, as when loading text
+	const char *output = argv[arg++];
+	std::map<std::string, Mapping> entries;
+	long lines = 0;
+	for (; arg < argc; ++arg)
+	{
+		std::string text;
+		if (!Read(argv[arg], text))
+		{
+			fprintf(stderr, "%s: cannot read %s\n", argv[0], argv[arg]);
+			return EXIT_FAILURE;
+		}
+		
+		size_t pos = 0;
+		while (pos < text.size())
+		{
+			size_t end = text.find_first_of("\r\n", pos);
+			if (end == std::string::npos)
+				end = text.size();
+			std::string line = text.substr(pos, end - pos);
+			pos = end + 1;
+			
+			size_t start = line.find_first_not_of(" \t");
+			if (start == std::string::npos || line[start] == '#')
+				continue;
+			
+			lines++;
+			Mapping map;
+			if (Parse(line.substr(start), map, platform))
+				entries[std::string((const char *) map.guid, sizeof (map.guid))] = map;
+		}
+	}
+	
+	std::vector<Mapping> maps;
+	for (std::map<std::string, Mapping>::const_iterator it = entries.begin(); it != entries.end(); ++it)
+		maps.push_back(it->second);
+	
+	std::string blob = Compile(maps, platform);
+	if (blob.empty())
+	{
+		fprintf(stderr, "%s: cannot build the index\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	
+	FILE *fp = fopen(output, "wb");
+	bool written = fp && fwrite(blob.data(), 1, blob.size(), fp) == blob.size();
+	if (fp)
+		written = !fclose(fp) && written;
+	if (!written)
+	{
+		fprintf(stderr, "%s: cannot write %s\n", argv[0], output);
+		remove(output);
+		return EXIT_FAILURE;
+	}
+	
+	printf("%s: %lu mappings for %s (of %ld lines), %lu bytes\n", output,
+		(unsigned long) maps.size(), platform, lines, (unsigned long) blob.size());
+	return EXIT_SUCCESS;
+}
+
+//..............................................................................
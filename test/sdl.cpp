@@ -0,0 +1,222 @@
+/*******************************************************
+ * SDL joystick test application -- main file          *
+ *                                                     *
+ * Author: agent                                       *
+ *                                                     *
+ * Date: 19:40 19-10-2026                              *
+ *                                                     *
+ * Description: Runs the SDL backend against virtual   *
+ *              joysticks, so it needs no hardware.    *
+ *******************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <SDL.h>
+
+#include "engine.h"
+
+using Engine::Value;
+
+//------------------------------------------------------------------------------
+
+/// Script visible part of a Joystick
+struct Joy
+{
+	int id, button_count, axis_count;
+	int x, y, z, u, v, w;
+	int pov;
+	unsigned int buttons;
+};
+
+/// Script visible part of a JoystickState
+struct State
+{
+	int id;
+	int x, y, z, u, v, w;
+	int pov;
+	unsigned int buttons, pad_buttons;
+	int pad_axis[6];
+	int mapped, input_age;
+};
+
+int failed = 0;
+
+void Check(const char *what, bool ok)
+{
+	printf("  %-40s %s\n", what, ok ? "ok" : "FAILED");
+	if (!ok)
+		failed++;
+}
+
+long Call(const char *name, Value arg)
+{
+	Value args[] = { arg };
+	return Engine::Call(name, 1, args);
+}
+
+long Call(const char *name, Value arg, Value param)
+{
+	Value args[] = { arg, param };
+	return Engine::Call(name, 2, args);
+}
+
+void Frame()
+{
+	Engine::Trigger(AGSE_PRERENDER, 0);
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char *argv[])
+{
+	if (SDL_Init(SDL_INIT_JOYSTICK))
+	{
+		printf("SDL: %s\n", SDL_GetError());
+		return EXIT_FAILURE;
+	}
+	
+	// A virtual pad is set from here and read by the plugin like any other
+	int index = SDL_JoystickAttachVirtual(SDL_JOYSTICK_TYPE_GAMECONTROLLER, 6, 16, 1);
+	SDL_Joystick *pad = SDL_JoystickOpen(index);
+	if (!pad)
+	{
+		printf("SDL: %s\n", SDL_GetError());
+		return EXIT_FAILURE;
+	}
+	
+	Engine::Initialize();
+	Value debug[] = {-2};
+	printf("%s\n", (const char *) Engine::Call("JoystickName", 1, debug));
+	
+	printf("Devices:\n");
+	Check("one joystick found", (long) Engine::Call("JoystickCount", 0, NULL) == 1);
+	Check("not hooked while none is open", !Engine::Hooked(AGSE_PRERENDER));
+	
+	Joy *joy = (Joy *) Call("Joystick::Open", 0);
+	Check("opened", joy && joy->id == 0);
+	Check("hooked while open", Engine::Hooked(AGSE_PRERENDER));
+	Check("axis and button counts", joy->axis_count == 6 && joy->button_count == 16);
+	
+	printf("Input:\n");
+	SDL_JoystickSetVirtualAxis(pad, 0, 12000);
+	SDL_JoystickSetVirtualAxis(pad, 5, -20000);
+	SDL_JoystickSetVirtualButton(pad, 3, 1);
+	SDL_JoystickSetVirtualHat(pad, 0, SDL_HAT_RIGHT);
+	Frame();
+	Check("axes follow", joy->x == 12000 && joy->w == -20000);
+	Check("button down", Call("Joystick::IsButtonDown", joy, 3) && joy->buttons == 8);
+	Check("hat as pov", joy->pov == 2);
+	
+	// The virtual pad's own GUID, with raw button 3 as A and axis 5 as a trigger
+	char guid[33], mapping[128];
+	SDL_JoystickGetGUIDString(SDL_JoystickGetGUID(pad), guid, sizeof (guid));
+	snprintf(mapping, sizeof (mapping), "%s,Virtual,a:b3,leftx:a0,righttrigger:a5,dpright:h0.2,", guid);
+	Value mappings[] = { mapping };
+	Check("mapping added", (long) Engine::Call("JoystickAddMappings", 1, mappings) == 1);
+	Frame();
+	Check("mapped", Call("Joystick::IsMapped", joy) == 1);
+	Check("pad button and dpad", Call("Joystick::IsPadButtonDown", joy, 0)
+		&& Call("Joystick::IsPadButtonDown", joy, 14) && !Call("Joystick::IsPadButtonDown", joy, 1));
+	Check("pad axes", Call("Joystick::GetPadAxis", joy, 0) == 12000
+		&& Call("Joystick::GetPadAxis", joy, 5) == (-20000 + 32768) / 2);
+	
+	State *state = (State *) Call("Joystick::GetState", joy, 0);
+	Check("state snapshot", state && state->id == 0 && state->x == 12000 && state->w == -20000
+		&& state->pov == 2 && state->buttons == 8 && state->pad_buttons == ((1 << 0) | (1 << 14))
+		&& state->pad_axis[0] == 12000 && state->mapped);
+	Check("state refilled in place", (State *) Call("Joystick::GetState", joy, state) == state);
+	
+	// Jump on pad A, walk on the raw x axis and pushed back by the pov
+	long jump = Call("Joystick::Action", "Jump");
+	long walk = Call("Joystick::Action", "Walk");
+	Value bindjump[] = {jump, 0, 4, 0, 16384, 32767, 0};
+	Value bindwalk[] = {walk, 0, 5, 0, 8000, 32767, 0};
+	Value bindback[] = {walk, 0, 3, 2, 16384, -10000, 0};
+	Check("actions bound", Engine::Call("Joystick::BindAction", 7, bindjump)
+		&& Engine::Call("Joystick::BindAction", 7, bindwalk)
+		&& Engine::Call("Joystick::BindAction", 7, bindback));
+	Frame();
+	Check("actions down", Call("Joystick::IsActionDown", jump) && Call("Joystick::IsActionDown", walk));
+	Check("action value", Call("Joystick::GetActionValue", walk) == 12000 - 10000);
+	
+	// Another set has none of these bindings; switching back needs no rebinding
+	long menu = Call("Joystick::ActionSet", "Menu");
+	Check("set switched", Call("Joystick::SetActionSet", menu)
+		&& (long) Engine::Call("Joystick::GetActionSet", 0, NULL) == menu);
+	Frame();
+	Check("other set not evaluated", !Call("Joystick::IsActionDown", jump));
+	Call("Joystick::SetActionSet", 0);
+	Frame();
+	Check("default set again", Call("Joystick::IsActionDown", jump));
+	
+	SDL_JoystickSetVirtualButton(pad, 3, 0);
+	Frame();
+	Check("button up", joy->buttons == 0);
+	Check("action up", !Call("Joystick::IsActionDown", jump));
+	
+	// An engine that drains SDL's queue itself leaves no events to read
+	SDL_JoystickSetVirtualAxis(pad, 2, 7000);
+	SDL_JoystickSetVirtualButton(pad, 1, 1);
+	SDL_PumpEvents();
+	SDL_FlushEvents(SDL_FIRSTEVENT, SDL_LASTEVENT);
+	Frame();
+	Check("state without events", joy->z == 7000 && joy->buttons == 2);
+	SDL_JoystickSetVirtualButton(pad, 1, 0);
+	Frame();
+	
+	// Nor does the plugin take them from an engine that reads them
+	SDL_Event event;
+	Check("events left queued", SDL_PeepEvents(&event, 1, SDL_PEEKEVENT,
+		SDL_JOYBUTTONUP, SDL_JOYBUTTONUP) == 1 && event.jbutton.button == 1);
+	SDL_FlushEvents(SDL_FIRSTEVENT, SDL_LASTEVENT);
+	
+	// The aggregate of the one device is that device
+	Joy *all = (Joy *) Call("Joystick::Open", -3);
+	Frame();
+	Check("aggregate open", all && all->id == -3 && Call("Joystick::IsOpen", -3));
+	Check("aggregate follows", all->x == 12000 && all->w == -20000 && all->pov == 2
+		&& Call("Joystick::IsMapped", all));
+	
+	printf("Hotplug:\n");
+	SDL_JoystickClose(pad);
+	SDL_JoystickDetachVirtual(index);
+	Frame();
+	Check("unplugged", Call("Joystick::Unplugged", joy) == 1);
+	Check("aggregate unplugged", Call("Joystick::Unplugged", all) == 1 && all->x == 0);
+	
+	index = SDL_JoystickAttachVirtual(SDL_JOYSTICK_TYPE_GAMECONTROLLER, 6, 16, 1);
+	pad = SDL_JoystickOpen(index);
+	Frame();
+	Check("rescan finds it again", (long) Engine::Call("JoystickRescan", 0, NULL) == 1);
+	Check("same joystick, plugged in", (long) Engine::Call("JoystickCount", 0, NULL) == 1
+		&& Call("Joystick::Unplugged", joy) == 0);
+	
+	SDL_JoystickSetVirtualAxis(pad, 1, 3000);
+	Frame();
+	Check("input after replug", joy->y == 3000);
+	Check("aggregate after replug", all->y == 3000);
+	
+	// Without an instance of its own the device is still read, not opened
+	Call("Joystick::Close", joy);
+	SDL_JoystickSetVirtualAxis(pad, 0, -9000);
+	Frame();
+	Value counters[] = {-4};
+	const char *report = (const char *) Engine::Call("JoystickName", 1, counters);
+	Check("aggregate alone", all->x == -9000 && strstr(report, "open=0 "));
+	
+	Call("Joystick::Close", all);
+	Check("unhooked once closed", !Engine::Hooked(AGSE_PRERENDER));
+	Check("hook checks", !Engine::Misses());
+	
+	Engine::Terminate();
+	SDL_JoystickClose(pad);
+	SDL_JoystickDetachVirtual(index);
+	SDL_Quit();
+	
+	printf("%s\n", failed ? "FAILED" : "All passed");
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+//..............................................................................